@@ -0,0 +1,819 @@
+// Startup and hot path benchmarks, run from the repository root so the
+// models/ and skybox/ paths resolve the same way they do for the renderer.
+// GL cases run in a surfaceless EGL context (Mesa llvmpipe is enough), every case gets warm-up
+// runs before the timed repetitions, and --json writes all results for regression tracking.
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>     // Key codes for the camera header, no window is opened
+
+#include <my_shader.h>
+#include <my_benchmark.h>
+#include <my_camera.h>
+#include <my_gl_state.h>
+#include <my_gpu_query.h>
+#include <my_headless.h>
+#include <my_model.h>
+#include <my_occlusion.h>
+#include <my_scene_batch.h>
+#include <my_skybox.h>
+#include <my_thread_pool.h>
+#include <my_uniform_buffers.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Models the render benchmarks use, the import benchmark takes everything in models/
+const char* benchModels[] =
+{
+    "models/teapot_smooth.obj",
+    "models/teapot_flat.obj",
+    "models/donut.obj",
+    "models/sphere.obj",
+    "models/suzanne_monkey.obj"
+};
+
+const std::vector<std::string> benchCubemapFaces =
+{
+    "skybox/right.png",
+    "skybox/left.png",
+    "skybox/top.png",
+    "skybox/bottom.png",
+    "skybox/front.png",
+    "skybox/back.png"
+};
+
+const char benchCubemapContainer[] = "cache/bench_skybox.cubemap";
+
+// Untimed runs before the timed ones, so first-touch costs (page faults, file cache, driver
+// shader compiles) don't land in the first repetition
+const int BENCH_WARMUP_RUNS = 2;
+
+struct BenchResult
+{
+    std::string section;
+    std::string name;
+    int repetitions;
+    double minMs;
+    double medianMs;
+    double meanMs;
+    double maxMs;
+    double stdDevMs;
+    uint64_t operations;    // Work items per repetition, for the time per operation
+};
+
+// Every result of the run in order, for --json
+std::vector<BenchResult> benchResults;
+std::string benchSection;
+
+// Keeps the compiler from dropping work whose result nothing reads
+volatile float benchSink = 0.0f;
+
+void beginSection(const std::string& title)
+{
+    benchSection = title;
+    std::cout << "== " << title << " ==" << std::endl;
+}
+
+// Statistics of timed repetitions, recorded under the current section
+BenchResult summariseTimes(const std::string& name, const std::vector<double>& timesMs, uint64_t operations = 1)
+{
+    BenchResult result;
+    result.section = benchSection;
+    result.name = name;
+    result.repetitions = static_cast<int>(timesMs.size());
+    result.operations = operations;
+    result.minMs = *std::min_element(timesMs.begin(), timesMs.end());
+    result.maxMs = *std::max_element(timesMs.begin(), timesMs.end());
+    result.medianMs = summarise(timesMs).p50;
+    result.meanMs = 0.0;
+    for (double t : timesMs)
+        result.meanMs += t;
+    result.meanMs /= timesMs.size();
+    double squares = 0.0;
+    for (double t : timesMs)
+        squares += (t - result.meanMs) * (t - result.meanMs);
+    result.stdDevMs = timesMs.size() > 1 ? std::sqrt(squares / (timesMs.size() - 1)) : 0.0;
+    benchResults.push_back(result);
+    return result;
+}
+
+// Time fn over a number of repetitions after BENCH_WARMUP_RUNS untimed ones. operations is the
+// work one call of fn does (iterations of an inner loop)
+BenchResult runBenchmark(const std::string& name, int repetitions, const std::function<void()>& fn, uint64_t operations = 1)
+{
+    for (int i = 0; i < BENCH_WARMUP_RUNS; i++)
+        fn();
+
+    std::vector<double> timesMs;
+    for (int i = 0; i < repetitions; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        timesMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return summariseTimes(name, timesMs, operations);
+}
+
+void printResult(const BenchResult& result)
+{
+    std::cout << std::left << std::setw(48) << result.name << std::right << std::fixed << std::setprecision(3)
+        << " min " << std::setw(10) << result.minMs
+        << " median " << std::setw(10) << result.medianMs
+        << " max " << std::setw(10) << result.maxMs << " ms"
+        << " (+-" << std::setprecision(1) << 100.0 * result.stdDevMs / std::max(result.meanMs, 1e-9) << "%)";
+    if (result.operations > 1)
+        std::cout << " " << std::setprecision(2) << result.medianMs * 1.0e6 / result.operations << " ns/op";
+    std::cout << std::endl;
+}
+
+// Every result as JSON, times in milliseconds
+bool writeBenchJson(const std::string& path, const std::string& renderer)
+{
+    std::ofstream file(path);
+    if (!file)
+    {
+        std::cout << "ERROR::BENCHMARK:: Could not write " << path << std::endl;
+        return false;
+    }
+    file << std::fixed << std::setprecision(6) << "{\n  \"renderer\": " << jsonString(renderer)
+        << ",\n  \"warmup_runs\": " << BENCH_WARMUP_RUNS << ",\n  \"results\": [";
+    for (size_t i = 0; i < benchResults.size(); i++)
+    {
+        const BenchResult& result = benchResults[i];
+        file << (i ? ",\n" : "\n") << "    { \"section\": " << jsonString(result.section) << ", \"name\": " << jsonString(result.name)
+            << ", \"repetitions\": " << result.repetitions << ", \"min_ms\": " << result.minMs << ", \"median_ms\": " << result.medianMs
+            << ", \"mean_ms\": " << result.meanMs << ", \"max_ms\": " << result.maxMs << ", \"stddev_ms\": " << result.stdDevMs
+            << ", \"operations\": " << result.operations << ", \"ns_per_op\": " << result.medianMs * 1.0e6 / result.operations << " }";
+    }
+    file << "\n  ]\n}\n";
+    return static_cast<bool>(file);
+}
+
+// Every .obj in models/, in name order, so new models are covered without touching the benchmark
+std::vector<std::string> listBenchModels()
+{
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator("models", ec))
+    {
+        if (entry.path().extension() == ".obj")
+            paths.push_back(entry.path().generic_string());
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+// Cold Assimp import against a warm mesh cache read for every model
+void benchMeshCache()
+{
+    beginSection("Mesh cache: cold Assimp import vs warm cache load");
+    for (const std::string& path : listBenchModels())
+    {
+        std::vector<MeshData> meshData;
+        BenchResult cold = runBenchmark("cold import " + path, 3, [&]()
+        {
+            Model::importModelData(path, meshData);
+        });
+
+        // Make sure the cache is fresh before timing the warm path
+        if (!writeMeshCache(path, MODEL_IMPORT_FLAGS, meshData))
+        {
+            std::cout << "Could not write mesh cache for " << path << std::endl;
+            continue;
+        }
+
+        BenchResult warm = runBenchmark("warm cache " + path, 10, [&]()
+        {
+            if (!readMeshCache(path, MODEL_IMPORT_FLAGS, meshData))
+                std::cout << "Mesh cache miss for " << path << std::endl;
+        });
+
+        printResult(cold);
+        printResult(warm);
+        std::cout << "speedup " << std::setprecision(1) << cold.minMs / warm.minMs << "x" << std::endl;
+    }
+}
+
+// Cold PNG decode + upload against a warm pre-baked container upload
+void benchSkyboxLoad()
+{
+    beginSection("Skybox: cold PNG load vs warm container load");
+    ThreadPool pool;
+
+    BenchResult coldSequential = runBenchmark("cold PNG, sequential decode", 3, [&]()
+    {
+        GLuint texture = loadCubemap(benchCubemapFaces);
+        glFinish();
+        GLState::instance().deleteTexture(texture);
+    });
+    BenchResult coldParallel = runBenchmark("cold PNG, parallel decode (" + std::to_string(pool.size()) + " threads)", 3, [&]()
+    {
+        GLuint texture = loadCubemap(benchCubemapFaces, &pool);
+        glFinish();
+        GLState::instance().deleteTexture(texture);
+    });
+
+    // Bake (synchronously, no pool) so the warm runs always hit the container
+    std::remove(benchCubemapContainer);
+    GLuint baked = loadCubemap(benchCubemapFaces, nullptr, nullptr, benchCubemapContainer);
+    GLState::instance().deleteTexture(baked);
+
+    CubemapLoadStats stats;
+    BenchResult warm = runBenchmark("warm container", 10, [&]()
+    {
+        GLuint texture = loadCubemap(benchCubemapFaces, nullptr, &stats, benchCubemapContainer);
+        glFinish();
+        GLState::instance().deleteTexture(texture);
+    });
+    if (!stats.fromContainer)
+        std::cout << "Container was not used, warm numbers are PNG loads" << std::endl;
+
+    printResult(coldSequential);
+    printResult(coldParallel);
+    printResult(warm);
+    std::cout << "speedup " << std::setprecision(1) << coldParallel.minMs / warm.minMs << "x over parallel decode" << std::endl;
+}
+
+// Uniform set throughput for the refraction shader's per-object uniforms (camera and material
+// parameters live in uniform buffers): the old std::string + glGetUniformLocation path,
+// hashed name lookups and pre-resolved handles
+void benchUniformSets()
+{
+    beginSection("Uniforms: set throughput by lookup method");
+    Shader shader("shaders/refractionShader.vs", "shaders/refractionShader.fs");
+    shader.use();
+
+    const int frames = 2000, objects = 64;
+    const int setsPerFrame = objects * 3;
+    const uint64_t setsPerRun = static_cast<uint64_t>(frames) * setsPerFrame;
+    const glm::mat4 matrix(1.0f);
+    const GLuint program = shader.ID;
+
+    // What every set* call did before the location table: a std::string plus a driver lookup
+    auto legacyLocation = [program](const std::string& name) { return glGetUniformLocation(program, name.c_str()); };
+    BenchResult legacy = runBenchmark("std::string + glGetUniformLocation", 5, [&]()
+    {
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int object = 0; object < objects; object++)
+            {
+                glUniform1i(legacyLocation("skybox"), 0);
+                glUniformMatrix4fv(legacyLocation("model"), 1, GL_FALSE, &matrix[0][0]);
+                glUniform1i(legacyLocation("textureDiffuse" + std::to_string(0)), 0);
+            }
+        }
+        glFinish();
+    }, setsPerRun);
+
+    BenchResult hashed = runBenchmark("hashed name lookup", 5, [&]()
+    {
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int object = 0; object < objects; object++)
+            {
+                shader.setInt("skybox", 0);
+                shader.setMat4("model", matrix);
+                shader.setInt(TEXTURE_DIFFUSE_UNIFORMS[0], 0);
+            }
+        }
+        glFinish();
+    }, setsPerRun);
+
+    const GLint skybox = shader.uniform("skybox");
+    const GLint model = shader.uniform("model"), textureDiffuse = shader.uniform(TEXTURE_DIFFUSE_UNIFORMS[0]);
+    BenchResult handles = runBenchmark("pre-resolved handles", 5, [&]()
+    {
+        for (int frame = 0; frame < frames; frame++)
+        {
+            for (int object = 0; object < objects; object++)
+            {
+                shader.setInt(skybox, 0);
+                shader.setMat4(model, matrix);
+                shader.setInt(textureDiffuse, 0);
+            }
+        }
+        glFinish();
+    }, setsPerRun);
+
+    const double sets = static_cast<double>(setsPerRun);
+    for (const BenchResult& result : { legacy, hashed, handles })
+    {
+        printResult(result);
+        std::cout << "  " << std::fixed << std::setprecision(1) << sets / (result.minMs * 1000.0) << " M sets/s, "
+            << std::setprecision(2) << result.minMs * 1000000.0 / sets << " ns per set" << std::endl;
+    }
+}
+
+// Offscreen colour + depth target so rendering doesn't depend on the hidden window's size
+struct BenchTarget
+{
+    GLuint framebuffer = 0;
+    GLuint colour = 0;
+    GLuint depth = 0;
+    int width = 0;
+    int height = 0;
+};
+
+BenchTarget createBenchTarget(int width, int height)
+{
+    BenchTarget target;
+    target.width = width;
+    target.height = height;
+    glGenFramebuffers(1, &target.framebuffer);
+    glGenRenderbuffers(1, &target.colour);
+    glGenRenderbuffers(1, &target.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.colour);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colour);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Benchmark framebuffer incomplete" << std::endl;
+    glViewport(0, 0, width, height);
+    return target;
+}
+
+void destroyBenchTarget(BenchTarget& target)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glDeleteRenderbuffers(1, &target.colour);
+    glDeleteRenderbuffers(1, &target.depth);
+    target = BenchTarget();
+}
+
+// Load a model (through the mesh cache) in the vertex format shader reads
+bool loadBenchModel(Model& model, const char* path, const Shader& shader)
+{
+    model.setVertexFormatFor(shader);
+    std::vector<MeshData> meshData;
+    if (!Model::loadModelData(path, meshData))
+        return false;
+    model.uploadMeshes(std::move(meshData));
+    return true;
+}
+
+// The same camera path rendered at full detail and with distance based LODs.
+// The camera pulls back from a grid of teapots, so most of the path is spent on small objects.
+void benchLodRender()
+{
+    beginSection("LOD: camera path with and without LODs");
+    const int width = 1920, height = 1080, frames = 240, gridSize = 5;
+    const float fovY = 50.0f, spacing = 3.0f;
+
+    BenchTarget target = createBenchTarget(width, height);
+    Shader shader("shaders/refractionShader.vs", "shaders/refractionShader.fs");
+    Model teapot(GeometryRetention::Release);
+    if (!loadBenchModel(teapot, benchModels[0], shader))
+    {
+        destroyBenchTarget(target);
+        return;
+    }
+
+    const glm::mat4 projection = glm::perspective(glm::radians(fovY), static_cast<float>(width) / height, 0.1f, 1000.0f);
+    UniformBuffer<CameraBlock> cameraBuffer(CAMERA_BLOCK_BINDING);
+    UniformBuffer<MaterialBlock> materialBuffer(MATERIAL_BLOCK_BINDING);
+    bindFrameUniformBlocks(shader);
+    materialBuffer.update({ 0.75f, 0.75f, 0.75f, 0.02f });
+    shader.use();
+    shader.setInt("skybox", 0);
+    GLState::instance().enable(GL_DEPTH_TEST);
+
+    for (bool useLods : { false, true })
+    {
+        std::vector<double> frameMs;
+        size_t triangles = 0;
+        double totalMs = 0.0;
+        // The first position is drawn BENCH_WARMUP_RUNS times untimed before the path starts
+        for (int frame = -BENCH_WARMUP_RUNS; frame < frames; frame++)
+        {
+            // Dolly out from 4 to 120 units while circling the grid
+            const float t = static_cast<float>(std::max(frame, 0)) / (frames - 1);
+            const float distance = 4.0f + t * t * 116.0f;
+            const float angle = t * 3.14159265f;
+            const glm::vec3 cameraPosition(std::sin(angle) * distance, 2.0f, std::cos(angle) * distance);
+            LodSelection selection = makeLodSelection(cameraPosition, fovY, static_cast<float>(height), 1.0f);
+            selection.enabled = useLods;
+
+            auto start = std::chrono::steady_clock::now();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            cameraBuffer.update(makeCameraBlock(glm::lookAt(cameraPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)), projection));
+            for (int x = 0; x < gridSize; x++)
+            {
+                for (int z = 0; z < gridSize; z++)
+                {
+                    const glm::mat4 model = glm::translate(glm::mat4(1.0f),
+                        glm::vec3((x - gridSize / 2) * spacing, 0.0f, (z - gridSize / 2) * spacing));
+                    shader.setMat4("model", model);
+                    shader.setMat3("normalMatrix", normalMatrix(model));
+                    const size_t drawn = teapot.draw(shader, model, selection);
+                    if (frame >= 0)
+                        triangles += drawn;
+                }
+            }
+            glFinish();
+            if (frame < 0)
+                continue;
+            frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            totalMs += frameMs.back();
+        }
+
+        const char* name = useLods ? "camera path, LODs" : "camera path, full detail";
+        summariseTimes(name, frameMs);
+        std::sort(frameMs.begin(), frameMs.end());
+        std::cout << std::left << std::setw(48) << name << std::right
+            << std::fixed << std::setprecision(3)
+            << " mean " << std::setw(8) << totalMs / frames << " ms"
+            << " p95 " << std::setw(8) << frameMs[frames * 95 / 100] << " ms"
+            << " triangles/frame " << std::setw(9) << triangles / frames
+            << " Mtri/s " << std::setprecision(1) << triangles / (totalMs * 1000.0) << std::endl;
+    }
+
+    destroyBenchTarget(target);
+}
+
+// A grid of objects cycling through the scene models, drawn one Model::draw per object
+// against a single SceneBatch multi-draw
+void benchSceneBatch()
+{
+    beginSection("Scene batch: per-object draws vs one multi-draw");
+    const int width = 1280, height = 720;
+    BenchTarget target = createBenchTarget(width, height);
+
+    Shader shader("shaders/refractionShader.vs", "shaders/refractionShader.fs");
+    Shader batchShader("shaders/refractionBatch.vs", "shaders/refractionShader.fs");
+    UniformBuffer<CameraBlock> cameraBuffer(CAMERA_BLOCK_BINDING);
+    UniformBuffer<MaterialBlock> materialBuffer(MATERIAL_BLOCK_BINDING);
+    bindFrameUniformBlocks(shader);
+    bindFrameUniformBlocks(batchShader);
+    materialBuffer.update({ 0.75f, 0.75f, 0.75f, 0.02f });
+
+    // Scene models (not the flat teapot), CPU geometry kept for the batch
+    const int modelCount = 4;
+    const char* scenePaths[modelCount] = { benchModels[0], benchModels[2], benchModels[3], benchModels[4] };
+    std::vector<Model> models;
+    models.reserve(modelCount);
+    SceneBatch batch(selectVertexFormat(batchShader.activeAttributes()));
+    for (const char* path : scenePaths)
+    {
+        models.emplace_back(GeometryRetention::Keep);
+        if (!loadBenchModel(models.back(), path, shader))
+        {
+            destroyBenchTarget(target);
+            return;
+        }
+        batch.addModel(models.back());
+    }
+    batch.upload();
+    batch.bindShader(batchShader);
+    std::cout << (batch.usesIndirectDraws() ? "glMultiDrawElementsIndirect" : "glDrawElementsBaseVertex fallback (no GL 4.3)") << std::endl;
+
+    const GLint modelUniform = shader.uniform("model"), normalMatrixUniform = shader.uniform("normalMatrix");
+    GLState::instance().enable(GL_DEPTH_TEST);
+    for (int objectCount : { 4, 4096 })
+    {
+        // Square grid in front of the camera, far enough back to fit
+        const int side = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(objectCount))));
+        const float spacing = 3.0f;
+        std::vector<glm::mat4> transforms;
+        batch.clearObjects();
+        for (int i = 0; i < objectCount; i++)
+        {
+            const glm::vec3 position((i % side - side * 0.5f) * spacing, (i / side - side * 0.5f) * spacing, 0.0f);
+            transforms.push_back(glm::translate(glm::mat4(1.0f), position));
+            batch.addObject(i % modelCount, transforms.back());
+        }
+        const glm::mat4 projection = glm::perspective(glm::radians(50.0f), static_cast<float>(width) / height, 0.1f, 1000.0f);
+        const glm::vec3 eye(0.0f, 0.0f, side * spacing * 1.2f + 5.0f);
+        cameraBuffer.update(makeCameraBlock(glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)), projection));
+
+        const int repetitions = objectCount > 100 ? 20 : 200;
+        BenchResult separate = runBenchmark(std::to_string(objectCount) + " objects, per-object draws", repetitions, [&]()
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            shader.use();
+            for (int i = 0; i < objectCount; i++)
+            {
+                shader.setMat4(modelUniform, transforms[i]);
+                shader.setMat3(normalMatrixUniform, normalMatrix(transforms[i]));
+                models[i % modelCount].draw(shader);
+            }
+            glFinish();
+        });
+        BenchResult batched = runBenchmark(std::to_string(objectCount) + " objects, scene batch", repetitions, [&]()
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            batchShader.use();
+            batch.draw();
+            glFinish();
+        });
+        printResult(separate);
+        printResult(batched);
+        std::cout << "speedup " << std::setprecision(1) << separate.meanMs / batched.meanMs << "x, "
+            << batch.drawCount() << " draws in one submission" << std::endl;
+    }
+
+    batch.destroy();
+    destroyBenchTarget(target);
+}
+
+// Skybox fragments shaded when drawn first without depth testing (the old cube pass) against
+// drawn last with GL_LEQUAL behind the scene models, counted with GL_SAMPLES_PASSED
+void benchSkyboxOverdraw()
+{
+    beginSection("Skybox: first without depth test vs last with early-z");
+    const int width = 1920, height = 1080;
+    BenchTarget target = createBenchTarget(width, height);
+
+    Shader shader("shaders/refractionShader.vs", "shaders/refractionShader.fs");
+    Shader skyboxShader("shaders/skyboxShader.vs", "shaders/skyboxShader.fs");
+    UniformBuffer<CameraBlock> cameraBuffer(CAMERA_BLOCK_BINDING);
+    UniformBuffer<MaterialBlock> materialBuffer(MATERIAL_BLOCK_BINDING);
+    bindFrameUniformBlocks(shader);
+    bindFrameUniformBlocks(skyboxShader);
+    materialBuffer.update({ 0.75f, 0.75f, 0.75f, 0.02f });
+
+    // The renderer's four objects, seen from close enough that they cover a good part of the screen
+    const char* scenePaths[] = { benchModels[0], benchModels[3], benchModels[2], benchModels[4] };
+    const float distApart = 2.8f;
+    const glm::vec3 positions[] = { glm::vec3(-distApart, distApart, 0.0f), glm::vec3(distApart, distApart, 0.0f),
+        glm::vec3(-distApart, -distApart, 0.0f), glm::vec3(distApart, -distApart, 0.0f) };
+    std::vector<Model> models;
+    models.reserve(4);
+    for (const char* path : scenePaths)
+    {
+        models.emplace_back(GeometryRetention::Release);
+        if (!loadBenchModel(models.back(), path, shader))
+        {
+            destroyBenchTarget(target);
+            return;
+        }
+    }
+    GLuint cubemap = loadCubemap(benchCubemapFaces, nullptr, nullptr, benchCubemapContainer);
+    GLuint skyboxVAO = setupSkyboxVAO();
+
+    const glm::mat4 projection = glm::perspective(glm::radians(50.0f), static_cast<float>(width) / height, 0.1f, 1000.0f);
+    cameraBuffer.update(makeCameraBlock(glm::lookAt(glm::vec3(-2.0f, 0.0f, 10.0f), glm::vec3(-2.0f, 0.0f, 0.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f)), projection));
+    const GLint modelUniform = shader.uniform("model"), normalMatrixUniform = shader.uniform("normalMatrix");
+    GLState& state = GLState::instance();
+
+    auto drawModels = [&]()
+    {
+        shader.use();
+        for (int i = 0; i < 4; i++)
+        {
+            const glm::mat4 model = glm::translate(glm::mat4(1.0f), positions[i]);
+            shader.setMat4(modelUniform, model);
+            shader.setMat3(normalMatrixUniform, normalMatrix(model));
+            models[i].draw(shader);
+        }
+    };
+
+    SamplesPassedCounter samples;
+    uint64_t firstSamples = 0, lastSamples = 0;
+    state.enable(GL_DEPTH_TEST);
+    BenchResult first = runBenchmark("skybox first, no depth test", 50, [&]()
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        state.disable(GL_DEPTH_TEST);
+        skyboxShader.use();
+        samples.begin();
+        state.bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemap);
+        state.bindVertexArray(skyboxVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        samples.end();
+        state.enable(GL_DEPTH_TEST);
+        drawModels();
+        firstSamples = samples.finish();
+    });
+    BenchResult last = runBenchmark("skybox last, GL_LEQUAL on the far plane", 50, [&]()
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawModels();
+        skyboxShader.use();
+        samples.begin();
+        drawSkybox(skyboxVAO, cubemap);
+        samples.end();
+        lastSamples = samples.finish();
+    });
+
+    printResult(first);
+    printResult(last);
+    std::cout << "skybox fragments " << firstSamples << " -> " << lastSamples << " (" << std::setprecision(1)
+        << 100.0 * (1.0 - static_cast<double>(lastSamples) / std::max<uint64_t>(firstSamples, 1)) << "% fewer)" << std::endl;
+
+    samples.destroy();
+    state.deleteVertexArray(skyboxVAO);
+    state.deleteTexture(cubemap);
+    destroyBenchTarget(target);
+}
+
+// A grid of teapots hidden behind a large sphere, drawn as is and with occlusion queries from
+// the previous frame deciding (through conditional rendering) which teapots to draw
+void benchOcclusionCulling()
+{
+    beginSection("Occlusion culling: hidden teapots with and without conditional rendering");
+    const int width = 1280, height = 720, gridSize = 8;
+    BenchTarget target = createBenchTarget(width, height);
+
+    Shader shader("shaders/refractionShader.vs", "shaders/refractionShader.fs");
+    Shader proxyShader("shaders/occlusionProxy.vs", "shaders/occlusionProxy.fs");
+    UniformBuffer<CameraBlock> cameraBuffer(CAMERA_BLOCK_BINDING);
+    UniformBuffer<MaterialBlock> materialBuffer(MATERIAL_BLOCK_BINDING);
+    bindFrameUniformBlocks(shader);
+    bindFrameUniformBlocks(proxyShader);
+    materialBuffer.update({ 0.75f, 0.75f, 0.75f, 0.02f });
+
+    Model teapot(GeometryRetention::Release), sphere(GeometryRetention::Release);
+    if (!loadBenchModel(teapot, benchModels[0], shader) || !loadBenchModel(sphere, benchModels[3], shader))
+    {
+        destroyBenchTarget(target);
+        return;
+    }
+
+    // The sphere sits between the camera and the grid, scaled to cover it
+    const glm::vec3 eye(0.0f, 0.0f, 12.0f);
+    const glm::mat4 projection = glm::perspective(glm::radians(50.0f), static_cast<float>(width) / height, 0.1f, 1000.0f);
+    cameraBuffer.update(makeCameraBlock(glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)), projection));
+    const glm::mat4 occluder = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 6.0f)), glm::vec3(4.0f));
+    std::vector<glm::mat4> transforms;
+    for (int x = 0; x < gridSize; x++)
+    {
+        for (int y = 0; y < gridSize; y++)
+            transforms.push_back(glm::translate(glm::mat4(1.0f), glm::vec3((x - gridSize * 0.5f + 0.5f) * 0.6f,
+                (y - gridSize * 0.5f + 0.5f) * 0.6f, -4.0f)));
+    }
+
+    const GLint modelUniform = shader.uniform("model"), normalMatrixUniform = shader.uniform("normalMatrix");
+    GLState::instance().enable(GL_DEPTH_TEST);
+    OcclusionCuller occlusion(proxyShader);
+    for (bool useQueries : { false, true })
+    {
+        occlusion.enabled = useQueries;
+        BenchResult result = runBenchmark(useQueries ? "64 hidden teapots, occlusion queries" : "64 hidden teapots, no culling", 50, [&]()
+        {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            occlusion.begin();
+            shader.use();
+            shader.setMat4(modelUniform, occluder);
+            shader.setMat3(normalMatrixUniform, normalMatrix(occluder));
+            sphere.draw(shader);
+            for (unsigned int i = 0; i < static_cast<unsigned int>(transforms.size()); i++)
+            {
+                const GLuint query = occlusion.condition(i, teapot.boundsMin, teapot.boundsMax, transforms[i], eye);
+                shader.use();
+                shader.setMat4(modelUniform, transforms[i]);
+                shader.setMat3(normalMatrixUniform, normalMatrix(transforms[i]));
+                if (query)
+                    glBeginConditionalRender(query, GL_QUERY_NO_WAIT);
+                teapot.draw(shader);
+                if (query)
+                    glEndConditionalRender();
+            }
+            occlusion.drawProxies();
+            glFinish();
+        });
+        printResult(result);
+        if (useQueries)
+            std::cout << occlusion.stats().occluded << " of " << occlusion.stats().tested << " teapots occluded" << std::endl;
+    }
+
+    occlusion.destroy();
+    destroyBenchTarget(target);
+}
+
+// Mouse look as the render loop does it: every mouse event rebuilds the camera vectors, every
+// frame reads the view matrix (rebuilt only after a move)
+void benchCamera()
+{
+    beginSection("Camera: mouse look and view matrix");
+    const int calls = 1000000;
+    Camera camera(glm::vec3(-2.0f, 0.0f, 10.0f));
+    camera.setMouseSensitivity(0.1f);
+
+    // Offsets alternate so the pitch never sits on its clamp
+    BenchResult mouse = runBenchmark("processMouseMovement", 10, [&]()
+    {
+        for (int i = 0; i < calls; i++)
+            camera.processMouseMovement((i & 1) ? 3.0f : -3.0f, (i & 2) ? 2.0f : -2.0f);
+        benchSink = camera.front.x;
+    }, calls);
+    BenchResult cached = runBenchmark("getViewMatrix, unchanged camera", 10, [&]()
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < calls; i++)
+            sum += camera.getViewMatrix()[3][0];
+        benchSink = sum;
+    }, calls);
+    BenchResult moved = runBenchmark("processMouseMovement + getViewMatrix", 10, [&]()
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < calls; i++)
+        {
+            camera.processMouseMovement((i & 1) ? 3.0f : -3.0f, (i & 2) ? 2.0f : -2.0f);
+            sum += camera.getViewMatrix()[3][0];
+        }
+        benchSink = sum;
+    }, calls);
+    BenchResult viewProjection = runBenchmark("processMouseMovement + getViewProjectionMatrix", 10, [&]()
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < calls; i++)
+        {
+            camera.processMouseMovement((i & 1) ? 3.0f : -3.0f, (i & 2) ? 2.0f : -2.0f);
+            sum += camera.getViewProjectionMatrix()[3][0];
+        }
+        benchSink = sum;
+    }, calls);
+
+    for (const BenchResult& result : { mouse, cached, moved, viewProjection })
+        printResult(result);
+}
+
+// Mesh::updateModelMatrix on a loaded mesh (a translation and three axis rotations from its 6DoF)
+void benchMeshMatrix()
+{
+    beginSection("Mesh: updateModelMatrix");
+    const int calls = 1000000;
+    Shader shader("shaders/refractionShader.vs", "shaders/refractionShader.fs");
+    Model teapot(GeometryRetention::Release);
+    if (!loadBenchModel(teapot, benchModels[0], shader) || teapot.meshes.empty())
+        return;
+
+    Mesh& mesh = teapot.meshes[0];
+    BenchResult result = runBenchmark("updateModelMatrix", 10, [&]()
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < calls; i++)
+        {
+            mesh.mesh6DoF[rY] = static_cast<float>(i) * 0.001f;
+            mesh.updateModelMatrix();
+            sum += mesh.meshMatrix[0][0];
+        }
+        benchSink = sum;
+    }, calls);
+    printResult(result);
+}
+
+// Everything that needs a GL context, with one current
+void runGLBenchmarks()
+{
+    benchSkyboxLoad();
+    benchUniformSets();
+    benchMeshMatrix();
+    benchLodRender();
+    benchSceneBatch();
+    benchSkyboxOverdraw();
+    benchOcclusionCulling();
+
+    const GLStateStats& stateCalls = GLState::instance().total();
+    std::cout << "GL state calls over all GL benchmarks: " << stateCalls.issued << " issued, "
+        << stateCalls.elided << " elided by the state cache" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::string jsonPath;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--json results.json]" << std::endl;
+            return -1;
+        }
+    }
+
+    benchMeshCache();
+    benchCamera();
+
+    // Everything else needs GL, from a surfaceless context so no display is needed
+    HeadlessContext context;
+    std::string renderer = "none";
+    if (context.create())
+    {
+        renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        runGLBenchmarks();
+        context.destroy();
+    }
+    else
+        std::cout << "No GL context, skipping GL benchmarks" << std::endl;
+
+    if (!jsonPath.empty() && writeBenchJson(jsonPath, renderer))
+        std::cout << benchResults.size() << " results written to " << jsonPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,275 @@
+#ifndef MY_BENCHMARK_H
+#define MY_BENCHMARK_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Scripted benchmark runs: a keyframe file drives the camera and material for a fixed number of
+// frames at a fixed timestep, every frame's CPU time, GPU time, draws and triangles are recorded
+// and summarised into a JSON report. Same script, same frames, so builds can be compared.
+//
+// Script format, one keyframe per line in time order, '#' starts a comment:
+//   time  x y z  yaw pitch zoom  etaR etaG etaB F0  dispersion
+// Times are seconds, angles degrees, dispersion is none, weak or strong. Numbers are
+// interpolated linearly between keyframes, the dispersion preset holds until the next keyframe.
+
+const char* const BENCHMARK_DISPERSION_NAMES[] = { "none", "weak", "strong" };
+const float BENCHMARK_DISPERSION_AMOUNTS[] = { 0.0f, 0.01f, 0.05f };
+
+struct BenchmarkKeyframe
+{
+    float time = 0.0f;
+    glm::vec3 position = glm::vec3(0.0f);
+    float yaw = -90.0f;
+    float pitch = 0.0f;
+    float zoom = 50.0f;
+    float etaR = 0.8f;
+    float etaG = 0.8f;
+    float etaB = 0.8f;
+    float F0 = 0.02f;
+    int dispersion = 0;     // Index into BENCHMARK_DISPERSION_NAMES
+
+    // Red and blue spread apart by the dispersion preset, like the ImGui presets do
+    float dispersedEtaR() const { return etaR - BENCHMARK_DISPERSION_AMOUNTS[dispersion]; }
+    float dispersedEtaB() const { return etaB + BENCHMARK_DISPERSION_AMOUNTS[dispersion]; }
+};
+
+class BenchmarkScript
+{
+public:
+    std::string path;
+
+    bool load(const std::string& scriptPath)
+    {
+        path = scriptPath;
+        keyframes.clear();
+        std::ifstream file(scriptPath);
+        if (!file)
+        {
+            std::cout << "ERROR::BENCHMARK:: Could not open script " << scriptPath << std::endl;
+            return false;
+        }
+
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line))
+        {
+            lineNumber++;
+            line = line.substr(0, line.find('#'));
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+
+            std::istringstream fields(line);
+            BenchmarkKeyframe key;
+            std::string dispersion;
+            fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch >> key.zoom
+                >> key.etaR >> key.etaG >> key.etaB >> key.F0 >> dispersion;
+            key.dispersion = -1;
+            for (int i = 0; i < 3; i++)
+            {
+                if (dispersion == BENCHMARK_DISPERSION_NAMES[i])
+                    key.dispersion = i;
+            }
+            if (!fields || key.dispersion < 0 || (!keyframes.empty() && key.time < keyframes.back().time))
+            {
+                std::cout << "ERROR::BENCHMARK:: " << scriptPath << ":" << lineNumber << ": bad keyframe" << std::endl;
+                keyframes.clear();
+                return false;
+            }
+            keyframes.push_back(key);
+        }
+
+        if (keyframes.empty())
+        {
+            std::cout << "ERROR::BENCHMARK:: " << scriptPath << " has no keyframes" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // State at time, held at the first/last keyframe outside the script
+    BenchmarkKeyframe sample(float time) const
+    {
+        if (time <= keyframes.front().time)
+            return keyframes.front();
+        if (time >= keyframes.back().time)
+            return keyframes.back();
+
+        size_t next = 1;
+        while (keyframes[next].time < time)
+            next++;
+        const BenchmarkKeyframe& a = keyframes[next - 1];
+        const BenchmarkKeyframe& b = keyframes[next];
+        const float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 1.0f;
+
+        BenchmarkKeyframe key;
+        key.time = time;
+        key.position = a.position + (b.position - a.position) * t;
+        key.yaw = a.yaw + (b.yaw - a.yaw) * t;
+        key.pitch = a.pitch + (b.pitch - a.pitch) * t;
+        key.zoom = a.zoom + (b.zoom - a.zoom) * t;
+        key.etaR = a.etaR + (b.etaR - a.etaR) * t;
+        key.etaG = a.etaG + (b.etaG - a.etaG) * t;
+        key.etaB = a.etaB + (b.etaB - a.etaB) * t;
+        key.F0 = a.F0 + (b.F0 - a.F0) * t;
+        key.dispersion = a.dispersion;
+        return key;
+    }
+
+    float duration() const { return keyframes.empty() ? 0.0f : keyframes.back().time; }
+
+private:
+    std::vector<BenchmarkKeyframe> keyframes;
+};
+
+// Mean, percentiles (nearest rank) and maximum of a series
+struct BenchmarkSummary
+{
+    size_t count = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+BenchmarkSummary summarise(std::vector<double> values)
+{
+    BenchmarkSummary summary;
+    summary.count = values.size();
+    if (values.empty())
+        return summary;
+
+    std::sort(values.begin(), values.end());
+    auto percentile = [&values](double p)
+    {
+        const size_t rank = static_cast<size_t>(std::max(1.0, std::ceil(p / 100.0 * values.size())));
+        return values[std::min(rank, values.size()) - 1];
+    };
+    for (double value : values)
+        summary.mean += value;
+    summary.mean /= static_cast<double>(values.size());
+    summary.p50 = percentile(50.0);
+    summary.p90 = percentile(90.0);
+    summary.p99 = percentile(99.0);
+    summary.max = values.back();
+    return summary;
+}
+
+// JSON string literal of text (quotes and backslashes escaped)
+std::string jsonString(const std::string& text)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// Per-frame measurements of a run
+class BenchmarkRecorder
+{
+public:
+    void addFrame(double cpuMs, size_t draws, size_t triangles)
+    {
+        cpuTimes.push_back(cpuMs);
+        drawCounts.push_back(static_cast<double>(draws));
+        triangleCounts.push_back(static_cast<double>(triangles));
+    }
+
+    // GPU time of an earlier frame (GPU results arrive a few frames late)
+    void setGpuTime(uint64_t frame, double ms)
+    {
+        if (gpuTimes.size() <= frame)
+            gpuTimes.resize(frame + 1, -1.0);
+        gpuTimes[frame] = ms;
+    }
+
+    // Per-pass times of the run (see my_profiler.h), one sample per profiled frame
+    void addPass(const std::string& name, const std::vector<double>& cpuMs, const std::vector<double>& gpuMs)
+    {
+        passes.push_back({ name, cpuMs, gpuMs });
+    }
+
+    size_t frames() const { return cpuTimes.size(); }
+
+    // Write the summary as JSON, description holds extra top level "key": value pairs (already
+    // formatted, comma separated)
+    bool writeReport(const std::string& path, const std::string& description) const
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::BENCHMARK:: Could not write report " << path << std::endl;
+            return false;
+        }
+
+        std::vector<double> gpuMs;
+        for (double ms : gpuTimes)
+        {
+            if (ms >= 0.0)
+                gpuMs.push_back(ms);
+        }
+
+        file << std::fixed << std::setprecision(4) << "{\n";
+        if (!description.empty())
+            file << "  " << description << ",\n";
+        file << "  \"frames\": " << frames() << ",\n";
+        writeSummary(file, "  ", "cpu_ms", summarise(cpuTimes));
+        file << ",\n";
+        writeSummary(file, "  ", "gpu_ms", summarise(gpuMs));
+        file << ",\n";
+        writeSummary(file, "  ", "draws", summarise(drawCounts));
+        file << ",\n";
+        writeSummary(file, "  ", "triangles", summarise(triangleCounts));
+        if (!passes.empty())
+        {
+            file << ",\n  \"passes\": {\n";
+            for (size_t i = 0; i < passes.size(); i++)
+            {
+                file << "    " << jsonString(passes[i].name) << ": {\n";
+                writeSummary(file, "      ", "cpu_ms", summarise(passes[i].cpuMs));
+                file << ",\n";
+                writeSummary(file, "      ", "gpu_ms", summarise(passes[i].gpuMs));
+                file << "\n    }" << (i + 1 < passes.size() ? ",\n" : "\n");
+            }
+            file << "  }";
+        }
+        file << "\n}\n";
+        return static_cast<bool>(file);
+    }
+
+private:
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+    std::vector<double> drawCounts;
+    std::vector<double> triangleCounts;
+
+    struct PassSeries
+    {
+        std::string name;
+        std::vector<double> cpuMs;
+        std::vector<double> gpuMs;
+    };
+    std::vector<PassSeries> passes;
+
+    static void writeSummary(std::ostream& out, const char* indent, const char* name, const BenchmarkSummary& summary)
+    {
+        out << indent << "\"" << name << "\": { \"count\": " << summary.count << ", \"mean\": " << summary.mean
+            << ", \"p50\": " << summary.p50 << ", \"p90\": " << summary.p90 << ", \"p99\": " << summary.p99
+            << ", \"max\": " << summary.max << " }";
+    }
+};
+#endif // MY_BENCHMARK_H
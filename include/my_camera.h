@@ -5,6 +5,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
 #include <vector>
 
 // Constraints on pitch and zoom
@@ -19,7 +20,13 @@ const float PITCH = 0.0f;
 const float CAMERA_SPEED = 2.5f;
 const float MOUSE_SENSITIVITY = 0.1f;
 const float ZOOM = 50.0f; // FOV
+const float ASPECT_RATIO = 16.0f / 9.0f;
+const float NEAR_PLANE = 0.1f;
+const float FAR_PLANE = 1000.0f;
 
+// View and projection matrices are cached, each is rebuilt on first use after something it
+// depends on changed. Code assigning position, the direction vectors or zoom directly instead
+// of going through the methods must call markDirty().
 class Camera
 {
 public:
@@ -38,6 +45,9 @@ public:
     float movementSpeed;
     float mouseSensitivity;
     float zoom;
+    float aspectRatio;
+    float nearPlane;
+    float farPlane;
     bool fps;
     float fixedYPos;
     bool zoomEnabled;
@@ -52,6 +62,9 @@ public:
         , movementSpeed(CAMERA_SPEED)
         , mouseSensitivity(MOUSE_SENSITIVITY)
         , zoom(ZOOM)
+        , aspectRatio(ASPECT_RATIO)
+        , nearPlane(NEAR_PLANE)
+        , farPlane(FAR_PLANE)
     {
         this->position = position;
         this->worldUp = up;
@@ -80,12 +93,43 @@ public:
     {
         this->fps = fps;
         this->fixedYPos = yPos;
+        if (fps && position.y != yPos)
+        {
+            position.y = yPos;
+            viewDirty = true;
+        }
     }
 
     // Set zoom
     void setZoom(const float zoom)
     {
         this->zoom = zoom;
+        projectionDirty = true;
+    }
+
+    // Set the perspective projection's aspect ratio (width / height) and clip planes
+    void setProjection(const float aspectRatio, const float nearPlane, const float farPlane)
+    {
+        this->aspectRatio = aspectRatio;
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+        projectionDirty = true;
+    }
+
+    // Place the camera and point it by Euler angles (degrees), e.g. from a scripted path
+    void setPose(const glm::vec3& position, const float yaw, const float pitch)
+    {
+        this->position = position;
+        this->yaw = yaw;
+        this->pitch = std::max(MIN_PITCH, std::min(MAX_PITCH, pitch));
+        updateCameraVectors();
+    }
+
+    // Invalidate the cached matrices after assigning the public members directly
+    void markDirty()
+    {
+        viewDirty = true;
+        projectionDirty = true;
     }
 
     // Enable/Disable zoom
@@ -95,9 +139,43 @@ public:
     }
 
     // Returns the view matrix calculated using Euler Angles and the LookAt Matrix
-    glm::mat4 getViewMatrix()
+    const glm::mat4& getViewMatrix()
+    {
+        updateMatrices();
+        return view;
+    }
+
+    // Camera to world, the camera's basis and position (a rigid transform, no general inverse needed)
+    const glm::mat4& getInverseViewMatrix()
+    {
+        updateMatrices();
+        return inverseView;
+    }
+
+    // Perspective projection from zoom (vertical FOV), aspect ratio and clip planes
+    const glm::mat4& getProjectionMatrix()
+    {
+        updateMatrices();
+        return projection;
+    }
+
+    const glm::mat4& getInverseProjectionMatrix()
+    {
+        updateMatrices();
+        return inverseProjection;
+    }
+
+    // projection * view
+    const glm::mat4& getViewProjectionMatrix()
+    {
+        updateMatrices();
+        return viewProjection;
+    }
+
+    const glm::mat4& getInverseViewProjectionMatrix()
     {
-        return glm::lookAt(position, position + front, up);
+        updateMatrices();
+        return inverseViewProjection;
     }
 
     // Processes input received from keyboard
@@ -125,6 +203,7 @@ public:
         // If FPS camera, ignore y-coordinate changes
         if (fps)
             position.y = fixedYPos;
+        viewDirty = true;
     }
 
 
@@ -157,10 +236,41 @@ public:
                 zoom = MIN_ZOOM;
             if (zoom > MAX_ZOOM)
                 zoom = MAX_ZOOM;
+            projectionDirty = true;
         }
     }
 
 private:
+    // Cached matrices
+    glm::mat4 view, inverseView;
+    glm::mat4 projection, inverseProjection;
+    glm::mat4 viewProjection, inverseViewProjection;
+    bool viewDirty = true;
+    bool projectionDirty = true;
+
+    // Rebuild whatever changed since the last call
+    void updateMatrices()
+    {
+        if (!viewDirty && !projectionDirty)
+            return;
+
+        if (viewDirty)
+        {
+            view = glm::lookAt(position, position + front, up);
+            // Transposed rotation, translated back to the camera position
+            inverseView = glm::mat4(glm::transpose(glm::mat3(view)));
+            inverseView[3] = glm::vec4(position, 1.0f);
+        }
+        if (projectionDirty)
+        {
+            projection = glm::perspective(glm::radians(zoom), aspectRatio, nearPlane, farPlane);
+            inverseProjection = glm::inverse(projection);
+        }
+        viewProjection = projection * view;
+        inverseViewProjection = inverseView * inverseProjection;
+        viewDirty = projectionDirty = false;
+    }
+
     // Calculates the front vector from camera's new Euler Angles
     void updateCameraVectors()
     {
@@ -174,6 +284,7 @@ private:
         // Right and up vectors
         right = glm::normalize(glm::cross(front, worldUp));
         up = glm::normalize(glm::cross(right, front));
+        viewDirty = true;
     }
 };
 #endif // MY_CAMERA_H
@@ -0,0 +1,235 @@
+#ifndef MY_CUBEMAP_CACHE_H
+#define MY_CUBEMAP_CACHE_H
+
+#include <my_mapped_file.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Pre-baked cubemap container, the six faces (and optionally their mip chain)
+// stored as raw upload-ready pixels so a warm start maps the file and hands it
+// straight to glTexImage2D without decoding any PNGs.
+//
+// Layout (little endian):
+//   CubemapCacheHeader
+//   CubemapCacheSource[6], stamps of the source images the container was baked from
+//   level-major pixel data: for each mip level, faces +X -X +Y -Y +Z -Z, tightly packed
+//   rows, every face image starting on a 4-byte boundary
+const uint32_t CUBEMAP_CACHE_MAGIC = 0x31425543; // "CUB1"
+const uint32_t CUBEMAP_CACHE_VERSION = 1;
+const uint32_t CUBEMAP_FACE_COUNT = 6;
+
+struct CubemapCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t numChannels;
+    uint32_t mipLevels;
+};
+
+struct CubemapCacheSource
+{
+    int64_t mtime;
+    uint64_t size;
+};
+
+// Size of one mip level dimension
+uint32_t cubemapMipSize(uint32_t size, uint32_t level)
+{
+    uint32_t mipSize = size >> level;
+    return mipSize > 0 ? mipSize : 1;
+}
+
+// Byte size of one face image at a mip level, padded to 4 bytes
+size_t cubemapFaceBytes(const CubemapCacheHeader& header, uint32_t level)
+{
+    size_t bytes = static_cast<size_t>(cubemapMipSize(header.width, level)) * cubemapMipSize(header.height, level) * header.numChannels;
+    return (bytes + 3) & ~static_cast<size_t>(3);
+}
+
+// Mapped view of a container, valid as long as it's alive
+class CubemapCache
+{
+public:
+    CubemapCacheHeader header = {};
+
+    // Map the container at path, fails if it's missing, corrupt or older than the source faces
+    bool open(const std::string& path, const std::vector<std::string>& faces)
+    {
+        if (faces.size() != CUBEMAP_FACE_COUNT || !file.open(path))
+            return false;
+
+        const size_t sourcesOffset = sizeof(CubemapCacheHeader);
+        const size_t dataOffset = sourcesOffset + CUBEMAP_FACE_COUNT * sizeof(CubemapCacheSource);
+        if (file.size() < dataOffset)
+            return close();
+
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (header.magic != CUBEMAP_CACHE_MAGIC || header.version != CUBEMAP_CACHE_VERSION ||
+            header.width == 0 || header.height == 0 || header.mipLevels == 0 || header.mipLevels > 32 ||
+            header.numChannels == 0 || header.numChannels > 4)
+            return close();
+
+        // Stale if any source face changed since baking
+        for (uint32_t i = 0; i < CUBEMAP_FACE_COUNT; i++)
+        {
+            CubemapCacheSource stored, current;
+            std::memcpy(&stored, file.data() + sourcesOffset + i * sizeof(CubemapCacheSource), sizeof(stored));
+            if (!fileStamp(faces[i], current.mtime, current.size) || stored.mtime != current.mtime || stored.size != current.size)
+                return close();
+        }
+
+        // Index every face image
+        size_t offset = dataOffset;
+        images.clear();
+        for (uint32_t level = 0; level < header.mipLevels; level++)
+        {
+            for (uint32_t face = 0; face < CUBEMAP_FACE_COUNT; face++)
+            {
+                images.push_back(file.data() + offset);
+                offset += cubemapFaceBytes(header, level);
+            }
+        }
+        if (offset > file.size())
+            return close();
+
+        return true;
+    }
+
+    // Pixels of a face (0 = +X ... 5 = -Z) at a mip level
+    const unsigned char* image(uint32_t level, uint32_t face) const
+    {
+        return images[level * CUBEMAP_FACE_COUNT + face];
+    }
+
+private:
+    MappedFile file;
+    std::vector<const unsigned char*> images;
+
+    bool close()
+    {
+        file.close();
+        images.clear();
+        return false;
+    }
+};
+
+// Halve an image with a 2x2 box filter
+std::vector<unsigned char> downsampleCubemapFace(const unsigned char* src, uint32_t width, uint32_t height, uint32_t numChannels)
+{
+    const uint32_t dstWidth = width > 1 ? width / 2 : 1;
+    const uint32_t dstHeight = height > 1 ? height / 2 : 1;
+    std::vector<unsigned char> dst(static_cast<size_t>(dstWidth) * dstHeight * numChannels);
+
+    for (uint32_t y = 0; y < dstHeight; y++)
+    {
+        const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+        for (uint32_t x = 0; x < dstWidth; x++)
+        {
+            const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            for (uint32_t c = 0; c < numChannels; c++)
+            {
+                unsigned int sum = src[(static_cast<size_t>(y0) * width + x0) * numChannels + c]
+                    + src[(static_cast<size_t>(y0) * width + x1) * numChannels + c]
+                    + src[(static_cast<size_t>(y1) * width + x0) * numChannels + c]
+                    + src[(static_cast<size_t>(y1) * width + x1) * numChannels + c];
+                dst[(static_cast<size_t>(y) * dstWidth + x) * numChannels + c] = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+// Bake decoded faces into a container at path. With generateMips the full mip chain
+// is box filtered and stored too, otherwise only level 0.
+bool writeCubemapCache(const std::string& path, const std::vector<std::string>& faces, const std::vector<const unsigned char*>& faceData,
+    uint32_t width, uint32_t height, uint32_t numChannels, bool generateMips)
+{
+    if (faces.size() != CUBEMAP_FACE_COUNT || faceData.size() != CUBEMAP_FACE_COUNT)
+        return false;
+
+    CubemapCacheHeader header = {};
+    header.magic = CUBEMAP_CACHE_MAGIC;
+    header.version = CUBEMAP_CACHE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.numChannels = numChannels;
+    header.mipLevels = 1;
+    if (generateMips)
+    {
+        uint32_t largest = std::max(width, height);
+        while (largest > 1)
+        {
+            largest /= 2;
+            header.mipLevels++;
+        }
+    }
+
+    CubemapCacheSource sources[CUBEMAP_FACE_COUNT];
+    for (uint32_t i = 0; i < CUBEMAP_FACE_COUNT; i++)
+    {
+        if (!faceData[i] || !fileStamp(faces[i], sources[i].mtime, sources[i].size))
+            return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::path parent = std::filesystem::path(path).parent_path();
+    if (!parent.empty())
+        std::filesystem::create_directories(parent, ec);
+
+    // Write to a temporary file and rename so a reader never sees a half written container
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cout << "ERROR::CUBEMAP_CACHE:: Could not write " << tempPath << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(sources), sizeof(sources));
+
+        const char padding[4] = { 0, 0, 0, 0 };
+        std::vector<std::vector<unsigned char>> levelData(CUBEMAP_FACE_COUNT);
+        for (uint32_t level = 0; level < header.mipLevels; level++)
+        {
+            const uint32_t levelWidth = cubemapMipSize(width, level);
+            const uint32_t levelHeight = cubemapMipSize(height, level);
+            const size_t bytes = static_cast<size_t>(levelWidth) * levelHeight * numChannels;
+            for (uint32_t face = 0; face < CUBEMAP_FACE_COUNT; face++)
+            {
+                if (level > 0)
+                {
+                    const unsigned char* src = level == 1 ? faceData[face] : levelData[face].data();
+                    levelData[face] = downsampleCubemapFace(src, cubemapMipSize(width, level - 1), cubemapMipSize(height, level - 1), numChannels);
+                }
+                const unsigned char* pixels = level == 0 ? faceData[face] : levelData[face].data();
+                out.write(reinterpret_cast<const char*>(pixels), bytes);
+                out.write(padding, cubemapFaceBytes(header, level) - bytes);
+            }
+        }
+
+        if (!out)
+        {
+            std::cout << "ERROR::CUBEMAP_CACHE:: Failed writing " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+#endif // MY_CUBEMAP_CACHE_H
@@ -0,0 +1,158 @@
+#ifndef MY_FRAME_PACER_H
+#define MY_FRAME_PACER_H
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <thread>
+
+// Presents frames and paces the render loop. The mode picks the swap interval and whether the
+// CPU limits the frame rate itself:
+//   VSync      swap interval 1, one frame per refresh
+//   Adaptive   swap interval -1 (tears instead of waiting a whole refresh when late), VSync
+//              where the driver lacks the swap_control_tear extension
+//   Immediate  swap interval 0, no limiter
+//   FrameCap   swap interval 0, the CPU holds every frame to the cap: coarse sleeps while far
+//              from the deadline, then a spin for the last stretch (sleep overshoot is measured,
+//              not assumed)
+//   Uncapped   swap interval 0, no limiter, the mode for throughput measurements
+// Frame times are recorded per mode from one present to the next.
+
+enum class PresentMode
+{
+    VSync = 0,
+    Adaptive,
+    Immediate,
+    FrameCap,
+    Uncapped,
+    Count
+};
+
+const char* const PRESENT_MODE_NAMES[] = { "VSync", "Adaptive vsync", "VSync off", "Frame cap", "Uncapped (benchmark)" };
+
+// Running frame time statistics (Welford's algorithm, no history kept)
+struct FrameTimeStats
+{
+    uint64_t frames = 0;
+    double meanMs = 0.0;
+    double m2 = 0.0;
+    double minMs = std::numeric_limits<double>::max();
+    double maxMs = 0.0;
+
+    void add(double ms)
+    {
+        frames++;
+        const double delta = ms - meanMs;
+        meanMs += delta / static_cast<double>(frames);
+        m2 += delta * (ms - meanMs);
+        minMs = std::min(minMs, ms);
+        maxMs = std::max(maxMs, ms);
+    }
+
+    double variance() const { return frames > 1 ? m2 / static_cast<double>(frames - 1) : 0.0; }
+    double standardDeviation() const { return std::sqrt(variance()); }
+};
+
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FramePacer(GLFWwindow* window, PresentMode mode = PresentMode::VSync, double frameCapFps = 60.0)
+        : window(window)
+    {
+        adaptiveSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+        setFrameCap(frameCapFps);
+        setMode(mode);
+    }
+
+    // Switch mode, the window's context must be current
+    void setMode(PresentMode newMode)
+    {
+        currentMode = newMode;
+        if (currentMode == PresentMode::VSync || (currentMode == PresentMode::Adaptive && !adaptiveSupported))
+            glfwSwapInterval(1);
+        else if (currentMode == PresentMode::Adaptive)
+            glfwSwapInterval(-1);
+        else
+            glfwSwapInterval(0);
+
+        // The first frame after a switch would mix both modes
+        deadline = Clock::now() + framePeriod;
+        lastPresent = Clock::time_point();
+    }
+
+    void setFrameCap(double fps)
+    {
+        frameCapFps = std::max(fps, 1.0);
+        framePeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameCapFps));
+    }
+
+    // Wait for the frame cap if there is one, swap buffers and record the frame time
+    void present()
+    {
+        if (currentMode == PresentMode::FrameCap)
+        {
+            // Late by more than a frame: start again from now rather than rushing to catch up
+            const Clock::time_point now = Clock::now();
+            if (now > deadline + framePeriod)
+                deadline = now;
+            waitUntil(deadline);
+            deadline += framePeriod;
+        }
+
+        glfwSwapBuffers(window);
+
+        const Clock::time_point now = Clock::now();
+        if (lastPresent != Clock::time_point())
+            modeStats[static_cast<int>(currentMode)].add(std::chrono::duration<double, std::milli>(now - lastPresent).count());
+        lastPresent = now;
+    }
+
+    void resetStats()
+    {
+        for (FrameTimeStats& stats : modeStats)
+            stats = FrameTimeStats();
+    }
+
+    PresentMode mode() const { return currentMode; }
+    double frameCap() const { return frameCapFps; }
+    bool adaptiveVsyncSupported() const { return adaptiveSupported; }
+    const FrameTimeStats& stats() const { return modeStats[static_cast<int>(currentMode)]; }
+    const FrameTimeStats& stats(PresentMode mode) const { return modeStats[static_cast<int>(mode)]; }
+
+    // Measured oversleep of a 1 ms sleep, the margin left to spinning
+    double sleepMarginMs() const { return sleepOvershoot.meanMs + 2.0 * sleepOvershoot.standardDeviation(); }
+
+private:
+    GLFWwindow* window;
+    PresentMode currentMode = PresentMode::VSync;
+    bool adaptiveSupported = false;
+    double frameCapFps = 60.0;
+    Clock::duration framePeriod = Clock::duration::zero();
+    Clock::time_point deadline;
+    Clock::time_point lastPresent;
+    FrameTimeStats modeStats[static_cast<int>(PresentMode::Count)];
+    FrameTimeStats sleepOvershoot;
+
+    // Sleep in 1 ms steps while the deadline is further away than a sleep may overshoot, then spin
+    void waitUntil(Clock::time_point target)
+    {
+        for (;;)
+        {
+            const Clock::time_point start = Clock::now();
+            if (std::chrono::duration<double, std::milli>(target - start).count() <= 1.0 + sleepMarginMs())
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            sleepOvershoot.add(std::chrono::duration<double, std::milli>(Clock::now() - start).count() - 1.0);
+        }
+        while (Clock::now() < target)
+        {
+        }
+    }
+};
+#endif // MY_FRAME_PACER_H
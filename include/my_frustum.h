@@ -0,0 +1,152 @@
+#ifndef MY_FRUSTUM_H
+#define MY_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MY_FRUSTUM_SSE 1
+#endif
+
+// View-frustum culling of world-space bounding boxes. The six planes are extracted from a
+// view-projection matrix and kept as structure-of-arrays, padded to eight with a plane every
+// point is in front of, so a box is tested against four planes per SSE instruction.
+
+// Meshes tested by the last cull pass
+struct CullStats
+{
+    size_t tested = 0;
+    size_t visible = 0;
+    size_t culled = 0;
+};
+
+class Frustum
+{
+public:
+    // Planes of viewProjection (Gribb-Hartmann), normals point inwards and are normalised
+    void extract(const glm::mat4& viewProjection)
+    {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+        const glm::vec4 planes[6] =
+        {
+            rows[3] + rows[0],  // Left
+            rows[3] - rows[0],  // Right
+            rows[3] + rows[1],  // Bottom
+            rows[3] - rows[1],  // Top
+            rows[3] + rows[2],  // Near
+            rows[3] - rows[2]   // Far
+        };
+        for (int i = 0; i < PLANE_SLOTS; i++)
+        {
+            glm::vec4 plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            if (i < 6)
+                plane = planes[i] / glm::length(glm::vec3(planes[i]));
+            planeX[i] = plane.x;
+            planeY[i] = plane.y;
+            planeZ[i] = plane.z;
+            planeW[i] = plane.w;
+        }
+    }
+
+    // Whether the box (centre, half extents) is at least partly inside: it is outside when its
+    // centre is further behind some plane than the box reaches along that plane's normal
+    bool intersects(const glm::vec3& center, const glm::vec3& extents) const
+    {
+#ifdef MY_FRUSTUM_SSE
+        const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+        const __m128 ex = _mm_set1_ps(extents.x), ey = _mm_set1_ps(extents.y), ez = _mm_set1_ps(extents.z);
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        for (int i = 0; i < PLANE_SLOTS; i += 4)
+        {
+            const __m128 nx = _mm_load_ps(planeX + i), ny = _mm_load_ps(planeY + i), nz = _mm_load_ps(planeZ + i);
+            // Signed distance of the centre
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+                _mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(planeW + i)));
+            // Projected radius of the box, extents dotted with |normal|
+            const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex),
+                _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)), _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+            if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps())))
+                return false;
+        }
+        return true;
+#else
+        for (int i = 0; i < 6; i++)
+        {
+            const float distance = planeX[i] * center.x + planeY[i] * center.y + planeZ[i] * center.z + planeW[i];
+            const float radius = std::fabs(planeX[i]) * extents.x + std::fabs(planeY[i]) * extents.y + std::fabs(planeZ[i]) * extents.z;
+            if (distance + radius < 0.0f)
+                return false;
+        }
+        return true;
+#endif
+    }
+
+    // Object-space box [boundsMin, boundsMax] placed with modelMatrix, tested as the world-space
+    // box enclosing it
+    bool intersects(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& modelMatrix) const
+    {
+        const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        const glm::vec3 extents = (boundsMax - boundsMin) * 0.5f;
+        const glm::mat3 rotation = glm::mat3(modelMatrix);
+        const glm::vec3 worldExtents = glm::vec3(
+            std::fabs(rotation[0].x) * extents.x + std::fabs(rotation[1].x) * extents.y + std::fabs(rotation[2].x) * extents.z,
+            std::fabs(rotation[0].y) * extents.x + std::fabs(rotation[1].y) * extents.y + std::fabs(rotation[2].y) * extents.z,
+            std::fabs(rotation[0].z) * extents.x + std::fabs(rotation[1].z) * extents.y + std::fabs(rotation[2].z) * extents.z);
+        return intersects(glm::vec3(modelMatrix * glm::vec4(center, 1.0f)), worldExtents);
+    }
+
+private:
+    static const int PLANE_SLOTS = 8;
+
+    alignas(16) float planeX[PLANE_SLOTS];
+    alignas(16) float planeY[PLANE_SLOTS];
+    alignas(16) float planeZ[PLANE_SLOTS];
+    alignas(16) float planeW[PLANE_SLOTS];
+};
+
+// Frustum of one pass plus its counters, handed to the draw paths. Disabled culling passes
+// everything (and still counts it)
+class FrustumCuller
+{
+public:
+    bool enabled = true;
+
+    void begin(const glm::mat4& viewProjection)
+    {
+        frustum.extract(viewProjection);
+        counters = CullStats();
+    }
+
+    // Test one mesh's bounds
+    bool visible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& modelMatrix)
+    {
+        const bool inside = !enabled || frustum.intersects(boundsMin, boundsMax, modelMatrix);
+        counters.tested++;
+        if (inside)
+            counters.visible++;
+        else
+            counters.culled++;
+        return inside;
+    }
+
+    // Count meshes rejected together with their object's bounds
+    void cullMeshes(size_t count)
+    {
+        counters.tested += count;
+        counters.culled += count;
+    }
+
+    const Frustum& planes() const { return frustum; }
+    const CullStats& stats() const { return counters; }
+
+private:
+    Frustum frustum;
+    CullStats counters;
+};
+#endif // MY_FRUSTUM_H
@@ -0,0 +1,282 @@
+#ifndef MY_GL_STATE_H
+#define MY_GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Cache of the GL binding and enable state, calls that wouldn't change anything are skipped.
+// Everything that binds programs, VAOs, buffers or textures, or toggles capabilities, goes
+// through GLState::instance() so the cache stays truthful. Code that changes state behind its
+// back (and doesn't restore it) must call invalidate().
+// Only use from the thread owning the GL context.
+
+// Texture units the cache tracks, binds on higher units go straight to GL
+const GLuint GL_STATE_TEXTURE_UNITS = 16;
+
+// Issued and skipped state calls
+struct GLStateStats
+{
+    uint64_t issued = 0;
+    uint64_t elided = 0;
+};
+
+class GLState
+{
+public:
+    static GLState& instance()
+    {
+        static GLState state;
+        return state;
+    }
+
+    void useProgram(GLuint program)
+    {
+        if (!track(program == currentProgram))
+            return;
+        glUseProgram(program);
+        currentProgram = program;
+    }
+
+    void bindVertexArray(GLuint vertexArray)
+    {
+        if (!track(vertexArray == currentVertexArray))
+            return;
+        glBindVertexArray(vertexArray);
+        currentVertexArray = vertexArray;
+    }
+
+    // GL_ELEMENT_ARRAY_BUFFER is part of the bound VAO, it is always passed through
+    void bindBuffer(GLenum target, GLuint buffer)
+    {
+        GLuint* current = bufferSlot(target);
+        if (!track(current && *current == buffer))
+            return;
+        glBindBuffer(target, buffer);
+        if (current)
+            *current = buffer;
+    }
+
+    // Indexed binding, also changes the generic binding of target like glBindBufferBase does
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        track(false);
+        glBindBufferBase(target, index, buffer);
+        GLuint* current = bufferSlot(target);
+        if (current)
+            *current = buffer;
+    }
+
+    // unit is GL_TEXTURE0 + i, like glActiveTexture
+    void activeTexture(GLenum unit)
+    {
+        if (!track(unit == currentUnit))
+            return;
+        glActiveTexture(unit);
+        currentUnit = unit;
+    }
+
+    // Bind on the active unit
+    void bindTexture(GLenum target, GLuint texture)
+    {
+        GLuint* current = textureSlot(currentUnit - GL_TEXTURE0, target);
+        if (!track(current && *current == texture))
+            return;
+        glBindTexture(target, texture);
+        if (current)
+            *current = texture;
+    }
+
+    // Bind on texture unit index (0, 1, ...), only switching the active unit when needed
+    void bindTexture(GLuint unit, GLenum target, GLuint texture)
+    {
+        GLuint* current = textureSlot(unit, target);
+        if (current && *current == texture)
+        {
+            track(true);
+            return;
+        }
+        activeTexture(GL_TEXTURE0 + unit);
+        bindTexture(target, texture);
+    }
+
+    void enable(GLenum capability)
+    {
+        setEnabled(capability, true);
+    }
+
+    void disable(GLenum capability)
+    {
+        setEnabled(capability, false);
+    }
+
+    void setEnabled(GLenum capability, bool enabled)
+    {
+        signed char& current = capabilitySlot(capability);
+        if (!track(current == (enabled ? 1 : 0)))
+            return;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+        current = enabled ? 1 : 0;
+    }
+
+    void depthFunc(GLenum function)
+    {
+        if (!track(function == currentDepthFunc))
+            return;
+        glDepthFunc(function);
+        currentDepthFunc = function;
+    }
+
+    void depthMask(GLboolean mask)
+    {
+        if (!track(depthMaskKnown && mask == currentDepthMask))
+            return;
+        glDepthMask(mask);
+        currentDepthMask = mask;
+        depthMaskKnown = true;
+    }
+
+    // Deleting an object unbinds it, the cache has to forget it too (names get reused)
+    void deleteProgram(GLuint program)
+    {
+        if (currentProgram == program)
+            currentProgram = UNKNOWN;
+        glDeleteProgram(program);
+    }
+
+    void deleteVertexArray(GLuint vertexArray)
+    {
+        if (currentVertexArray == vertexArray)
+            currentVertexArray = UNKNOWN;
+        glDeleteVertexArrays(1, &vertexArray);
+    }
+
+    void deleteBuffer(GLuint buffer)
+    {
+        for (auto& slot : buffers)
+        {
+            if (slot.second == buffer)
+                slot.second = UNKNOWN;
+        }
+        glDeleteBuffers(1, &buffer);
+    }
+
+    void deleteTexture(GLuint texture)
+    {
+        for (GLuint& slot : textures)
+        {
+            if (slot == texture)
+                slot = UNKNOWN;
+        }
+        glDeleteTextures(1, &texture);
+    }
+
+    // Forget everything, the next call of each kind reaches GL
+    void invalidate()
+    {
+        currentProgram = UNKNOWN;
+        currentVertexArray = UNKNOWN;
+        currentUnit = UNKNOWN;
+        currentDepthFunc = UNKNOWN;
+        depthMaskKnown = false;
+        for (auto& slot : buffers)
+            slot.second = UNKNOWN;
+        for (GLuint& slot : textures)
+            slot = UNKNOWN;
+        for (auto& slot : capabilities)
+            slot.second = -1;
+    }
+
+    // Start counting a new frame, lastFrame() then returns the one that just ended
+    void beginFrame()
+    {
+        previousFrame = currentFrame;
+        currentFrame = GLStateStats();
+    }
+
+    const GLStateStats& lastFrame() const { return previousFrame; }
+    const GLStateStats& total() const { return totals; }
+
+private:
+    static const GLuint UNKNOWN = 0xffffffffu;
+
+    GLuint currentProgram = UNKNOWN;
+    GLuint currentVertexArray = UNKNOWN;
+    GLenum currentUnit = UNKNOWN;
+    GLenum currentDepthFunc = UNKNOWN;
+    GLboolean currentDepthMask = GL_TRUE;
+    bool depthMaskKnown = false;
+    std::vector<std::pair<GLenum, GLuint>> buffers;
+    std::vector<std::pair<GLenum, signed char>> capabilities;
+    GLuint textures[GL_STATE_TEXTURE_UNITS * 3];
+
+    GLStateStats currentFrame;
+    GLStateStats previousFrame;
+    GLStateStats totals;
+
+    GLState()
+    {
+        for (GLuint& slot : textures)
+            slot = UNKNOWN;
+    }
+
+    // Count a call, returns whether it has to reach GL
+    bool track(bool redundant)
+    {
+        if (redundant)
+        {
+            currentFrame.elided++;
+            totals.elided++;
+            return false;
+        }
+        currentFrame.issued++;
+        totals.issued++;
+        return true;
+    }
+
+    GLuint* bufferSlot(GLenum target)
+    {
+        if (target == GL_ELEMENT_ARRAY_BUFFER)
+            return nullptr;
+        for (auto& slot : buffers)
+        {
+            if (slot.first == target)
+                return &slot.second;
+        }
+        buffers.emplace_back(target, UNKNOWN);
+        return &buffers.back().second;
+    }
+
+    GLuint* textureSlot(GLuint unit, GLenum target)
+    {
+        if (unit >= GL_STATE_TEXTURE_UNITS)
+            return nullptr;
+        int index;
+        if (target == GL_TEXTURE_2D)
+            index = 0;
+        else if (target == GL_TEXTURE_CUBE_MAP)
+            index = 1;
+        else if (target == GL_TEXTURE_BUFFER)
+            index = 2;
+        else
+            return nullptr;
+        return &textures[unit * 3 + index];
+    }
+
+    signed char& capabilitySlot(GLenum capability)
+    {
+        for (auto& slot : capabilities)
+        {
+            if (slot.first == capability)
+                return slot.second;
+        }
+        capabilities.emplace_back(capability, static_cast<signed char>(-1));
+        return capabilities.back().second;
+    }
+};
+#endif // MY_GL_STATE_H
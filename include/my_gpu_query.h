@@ -0,0 +1,171 @@
+#ifndef MY_GPU_QUERY_H
+#define MY_GPU_QUERY_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Number of queries in flight per counter, results are read this many frames late so the
+// CPU never waits for the GPU
+const int GPU_QUERY_LATENCY = 3;
+
+// Counts the samples that pass the depth test between begin() and end() with GL_SAMPLES_PASSED,
+// one measurement per frame
+class SamplesPassedCounter
+{
+public:
+    SamplesPassedCounter()
+    {
+        glGenQueries(GPU_QUERY_LATENCY, queries);
+    }
+
+    ~SamplesPassedCounter()
+    {
+        destroy();
+    }
+
+    SamplesPassedCounter(const SamplesPassedCounter&) = delete;
+    SamplesPassedCounter& operator=(const SamplesPassedCounter&) = delete;
+
+    void begin()
+    {
+        // Collect the oldest query before reusing it
+        if (pending[next])
+        {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(queries[next], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+                collect(next);
+        }
+        glBeginQuery(GL_SAMPLES_PASSED, queries[next]);
+    }
+
+    void end()
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        pending[next] = true;
+        next = (next + 1) % GPU_QUERY_LATENCY;
+    }
+
+    // Latest finished measurement
+    uint64_t samples() const { return lastSamples; }
+
+    // Wait for everything in flight, for benchmarks that want this frame's number
+    uint64_t finish()
+    {
+        for (int i = 0; i < GPU_QUERY_LATENCY; i++)
+        {
+            const int index = (next + i) % GPU_QUERY_LATENCY;
+            if (pending[index])
+                collect(index);
+        }
+        return lastSamples;
+    }
+
+    // Delete the queries while the GL context is still current
+    void destroy()
+    {
+        if (queries[0])
+            glDeleteQueries(GPU_QUERY_LATENCY, queries);
+        queries[0] = 0;
+    }
+
+private:
+    GLuint queries[GPU_QUERY_LATENCY] = {};
+    bool pending[GPU_QUERY_LATENCY] = {};
+    int next = 0;
+    uint64_t lastSamples = 0;
+
+    void collect(int index)
+    {
+        GLuint64 result = 0;
+        glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &result);
+        lastSamples = result;
+        pending[index] = false;
+    }
+};
+
+// GPU time of every frame with GL_TIME_ELAPSED, results are read GPU_QUERY_LATENCY frames late.
+// Unlike SamplesPassedCounter no measurement is dropped: a query still in flight when its slot
+// comes round again is waited for (three frames on, it is practically always done)
+class GpuFrameTimer
+{
+public:
+    GpuFrameTimer()
+    {
+        glGenQueries(GPU_QUERY_LATENCY, queries);
+
+        // Mesa llvmpipe times the first query spanning any rendering in a context from zero, so
+        // one measurement around a depth clear is taken and thrown away. Construct it before the
+        // first frame, the clear hits whatever framebuffer is bound
+        GLuint64 discarded = 0;
+        glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glEndQuery(GL_TIME_ELAPSED);
+        glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &discarded);
+    }
+
+    ~GpuFrameTimer()
+    {
+        destroy();
+    }
+
+    GpuFrameTimer(const GpuFrameTimer&) = delete;
+    GpuFrameTimer& operator=(const GpuFrameTimer&) = delete;
+
+    // Start timing frame (any increasing id)
+    void begin(uint64_t frame)
+    {
+        if (pending[next])
+            collect(next);
+        frames[next] = frame;
+        glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+    }
+
+    void end()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[next] = true;
+        next = (next + 1) % GPU_QUERY_LATENCY;
+    }
+
+    // Collect everything in flight, oldest first
+    void finish()
+    {
+        for (int i = 0; i < GPU_QUERY_LATENCY; i++)
+        {
+            const int index = (next + i) % GPU_QUERY_LATENCY;
+            if (pending[index])
+                collect(index);
+        }
+    }
+
+    // (frame, milliseconds) of every finished measurement, in frame order
+    const std::vector<std::pair<uint64_t, double>>& results() const { return finished; }
+
+    // Delete the queries while the GL context is still current
+    void destroy()
+    {
+        if (queries[0])
+            glDeleteQueries(GPU_QUERY_LATENCY, queries);
+        queries[0] = 0;
+    }
+
+private:
+    GLuint queries[GPU_QUERY_LATENCY] = {};
+    uint64_t frames[GPU_QUERY_LATENCY] = {};
+    bool pending[GPU_QUERY_LATENCY] = {};
+    int next = 0;
+    std::vector<std::pair<uint64_t, double>> finished;
+
+    void collect(int index)
+    {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &nanoseconds);
+        finished.emplace_back(frames[index], static_cast<double>(nanoseconds) / 1.0e6);
+        pending[index] = false;
+    }
+};
+#endif // MY_GPU_QUERY_H
@@ -0,0 +1,183 @@
+#ifndef MY_HEADLESS_H
+#define MY_HEADLESS_H
+
+#include <glad/glad.h>
+
+// Keep Xlib out, its macros (None, Bool, Status) collide with ordinary names
+#ifndef EGL_NO_X11
+#define EGL_NO_X11
+#endif
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <my_gl_state.h>
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Rendering without a display: a surfaceless EGL context (EGL_MESA_platform_surfaceless, or the
+// default display with EGL_KHR_surfaceless_context) and a framebuffer object to draw into.
+// Works on Mesa llvmpipe with no GPU. Link with -lEGL.
+
+class HeadlessContext
+{
+public:
+    ~HeadlessContext()
+    {
+        destroy();
+    }
+
+    // Create a GL 3.3 core context, make it current and load the GL functions through it
+    bool create()
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        EGLint major = 0, minor = 0;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        {
+            std::cout << "ERROR::HEADLESS:: Could not initialise an EGL display" << std::endl;
+            display = EGL_NO_DISPLAY;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            std::cout << "ERROR::HEADLESS:: EGL has no desktop OpenGL" << std::endl;
+            destroy();
+            return false;
+        }
+
+        // No surface is ever created, but the default surface type (window) would match nothing
+        const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+        {
+            std::cout << "ERROR::HEADLESS:: No EGL config for desktop OpenGL" << std::endl;
+            destroy();
+            return false;
+        }
+
+        const EGLint contextAttributes[] =
+        {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        {
+            std::cout << "ERROR::HEADLESS:: Could not create a surfaceless GL 3.3 core context (EGL error 0x"
+                << std::hex << eglGetError() << std::dec << ")" << std::endl;
+            destroy();
+            return false;
+        }
+
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+        {
+            std::cout << "ERROR::HEADLESS:: Failed to initialize GLAD" << std::endl;
+            destroy();
+            return false;
+        }
+        GLState::instance().invalidate();
+        std::cout << "Headless EGL " << major << "." << minor << ": " << glGetString(GL_RENDERER) << std::endl;
+        return true;
+    }
+
+    void destroy()
+    {
+        if (display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        context = EGL_NO_CONTEXT;
+        display = EGL_NO_DISPLAY;
+    }
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+};
+
+// Framebuffer with an RGBA8 colour and a 24-bit depth attachment, standing in for the window
+class OffscreenTarget
+{
+public:
+    int width = 0;
+    int height = 0;
+
+    bool create(int targetWidth, int targetHeight)
+    {
+        width = targetWidth;
+        height = targetHeight;
+        glGenFramebuffers(1, &framebuffer);
+        glGenRenderbuffers(1, &colour);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, colour);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::HEADLESS:: Offscreen framebuffer " << width << "x" << height << " is incomplete" << std::endl;
+            destroy();
+            return false;
+        }
+        glViewport(0, 0, width, height);
+        return true;
+    }
+
+    // Draw into the target from now on
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+    }
+
+    // Save the colour attachment as a binary PPM (rows flipped to top-down)
+    bool writePPM(const std::string& path) const
+    {
+        std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 3);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            std::cout << "ERROR::HEADLESS:: Could not write " << path << std::endl;
+            return false;
+        }
+        std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+        for (int row = height - 1; row >= 0; row--)
+            std::fwrite(pixels.data() + static_cast<size_t>(row) * width * 3, 1, static_cast<size_t>(width) * 3, file);
+        std::fclose(file);
+        return true;
+    }
+
+    void destroy()
+    {
+        if (!framebuffer)
+            return;
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &colour);
+        glDeleteRenderbuffers(1, &depth);
+        framebuffer = colour = depth = 0;
+    }
+
+private:
+    GLuint framebuffer = 0, colour = 0, depth = 0;
+};
+#endif // MY_HEADLESS_H
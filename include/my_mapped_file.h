@@ -0,0 +1,169 @@
+#ifndef MY_MAPPED_FILE_H
+#define MY_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Modification time and size of a file, used to key on-disk caches.
+// Returns false if the file can't be found.
+bool fileStamp(const std::string& path, int64_t& mtime, uint64_t& size)
+{
+    std::error_code ec;
+    std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        return false;
+    uintmax_t fileSize = std::filesystem::file_size(path, ec);
+    if (ec)
+        return false;
+
+    mtime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+    size = static_cast<uint64_t>(fileSize);
+    return true;
+}
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() {}
+
+    explicit MappedFile(const std::string& path)
+    {
+        open(path);
+    }
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    // Move only, the mapping has a single owner
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            mapped = other.mapped;
+            mappedSize = other.mappedSize;
+#ifdef _WIN32
+            fileHandle = other.fileHandle;
+            mappingHandle = other.mappingHandle;
+            other.fileHandle = INVALID_HANDLE_VALUE;
+            other.mappingHandle = NULL;
+#endif
+            other.mapped = nullptr;
+            other.mappedSize = 0;
+        }
+        return *this;
+    }
+
+    // Map the file at path, returns false if it doesn't exist or is empty
+    bool open(const std::string& path)
+    {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mappingHandle == NULL)
+        {
+            close();
+            return false;
+        }
+
+        mapped = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        if (!mapped)
+        {
+            close();
+            return false;
+        }
+        mappedSize = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // The mapping keeps its own reference to the file
+        if (view == MAP_FAILED)
+            return false;
+
+        mapped = view;
+        mappedSize = static_cast<size_t>(fileStat.st_size);
+#endif
+        return true;
+    }
+
+    // Unmap the file
+    void close()
+    {
+#ifdef _WIN32
+        if (mapped)
+            UnmapViewOfFile(mapped);
+        if (mappingHandle != NULL)
+            CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE)
+            CloseHandle(fileHandle);
+        mappingHandle = NULL;
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (mapped)
+            munmap(mapped, mappedSize);
+#endif
+        mapped = nullptr;
+        mappedSize = 0;
+    }
+
+    bool isOpen() const { return mapped != nullptr; }
+    const unsigned char* data() const { return static_cast<const unsigned char*>(mapped); }
+    size_t size() const { return mappedSize; }
+
+private:
+    void* mapped = nullptr;
+    size_t mappedSize = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mappingHandle = NULL;
+#endif
+};
+#endif // MY_MAPPED_FILE_H
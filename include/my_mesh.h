@@ -5,10 +5,18 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
+#include <my_gl_state.h>
 #include <my_shader.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 struct Vertex 
@@ -18,12 +26,210 @@ struct Vertex
     glm::vec2 TexCoords;
 };
 
-struct Texture 
+// Registry owned GL texture, see my_texture_registry.h
+struct SharedTexture;
+
+struct Texture
 {
     unsigned int id;
     std::string path;
+    std::shared_ptr<SharedTexture> handle; // Keeps the GL texture alive
+};
+
+// One level of detail, a range of the mesh's index buffer
+struct MeshLod
+{
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;    // Largest object-space deviation from LOD 0
+};
+
+// CPU-side mesh as produced by the importer or the mesh cache, no GL objects yet
+struct MeshData
+{
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;  // All LODs back to back
+    std::vector<MeshLod> lods;          // Empty means a single level using every index
+    std::vector<std::string> texturePaths;
+};
+
+// Attribute locations shared by every mesh shader
+const GLuint POSITION_ATTRIBUTE = 0;
+const GLuint NORMAL_ATTRIBUTE = 1;
+const GLuint TEXCOORD_ATTRIBUTE = 2;
+
+// How vertex attributes are stored in the vertex buffer
+enum class VertexLayout
+{
+    Float,      // 32-bit floats, same as Vertex
+    Packed      // half-float position (8 bytes), 2_10_10_10 normal (4 bytes), half-float UV (4 bytes)
+};
+
+// GPU vertex format of a mesh, attributes the shader doesn't read are left out
+struct VertexFormat
+{
+    VertexLayout layout = VertexLayout::Float;
+    bool normals = true;
+    bool texCoords = true;
+
+    GLsizei positionBytes() const { return layout == VertexLayout::Packed ? 4 * sizeof(uint16_t) : 3 * sizeof(float); }
+    GLsizei normalBytes() const { return normals ? (layout == VertexLayout::Packed ? sizeof(uint32_t) : 3 * sizeof(float)) : 0; }
+    GLsizei texCoordBytes() const { return texCoords ? (layout == VertexLayout::Packed ? 2 * sizeof(uint16_t) : 2 * sizeof(float)) : 0; }
+    GLsizei stride() const { return positionBytes() + normalBytes() + texCoordBytes(); }
+
+    // Identical to the in-memory Vertex, can be uploaded without repacking
+    bool matchesVertex() const { return layout == VertexLayout::Float && normals && texCoords; }
+};
+
+// Pick the smallest format providing every attribute location set in attributeMask
+// (see Shader::activeAttributes)
+VertexFormat selectVertexFormat(unsigned int attributeMask, VertexLayout layout = VertexLayout::Packed)
+{
+    VertexFormat format;
+    format.layout = layout;
+    format.normals = (attributeMask & (1u << NORMAL_ATTRIBUTE)) != 0;
+    format.texCoords = (attributeMask & (1u << TEXCOORD_ATTRIBUTE)) != 0;
+    return format;
+}
+
+// Convert vertices to an interleaved buffer in the given format
+std::vector<unsigned char> packVertices(const std::vector<Vertex>& vertices, const VertexFormat& format)
+{
+    const size_t stride = format.stride();
+    std::vector<unsigned char> packed(vertices.size() * stride);
+    unsigned char* out = packed.data();
+    for (const Vertex& vertex : vertices)
+    {
+        unsigned char* attribute = out;
+        if (format.layout == VertexLayout::Packed)
+        {
+            uint16_t position[4] = { glm::packHalf1x16(vertex.Position.x), glm::packHalf1x16(vertex.Position.y),
+                glm::packHalf1x16(vertex.Position.z), glm::packHalf1x16(1.0f) };
+            std::memcpy(attribute, position, sizeof(position));
+            attribute += sizeof(position);
+            if (format.normals)
+            {
+                uint32_t normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f));
+                std::memcpy(attribute, &normal, sizeof(normal));
+                attribute += sizeof(normal);
+            }
+            if (format.texCoords)
+            {
+                uint16_t texCoords[2] = { glm::packHalf1x16(vertex.TexCoords.x), glm::packHalf1x16(vertex.TexCoords.y) };
+                std::memcpy(attribute, texCoords, sizeof(texCoords));
+            }
+        }
+        else
+        {
+            std::memcpy(attribute, &vertex.Position, sizeof(vertex.Position));
+            attribute += sizeof(vertex.Position);
+            if (format.normals)
+            {
+                std::memcpy(attribute, &vertex.Normal, sizeof(vertex.Normal));
+                attribute += sizeof(vertex.Normal);
+            }
+            if (format.texCoords)
+                std::memcpy(attribute, &vertex.TexCoords, sizeof(vertex.TexCoords));
+        }
+        out += stride;
+    }
+    return packed;
+}
+
+// Point the attributes of the bound VAO at the bound vertex buffer, starting at byte offset
+void setupVertexAttributes(const VertexFormat& format, size_t offset = 0)
+{
+    const GLsizei stride = format.stride();
+    const bool packed = format.layout == VertexLayout::Packed;
+
+    // Vertex positions
+    glEnableVertexAttribArray(POSITION_ATTRIBUTE);
+    glVertexAttribPointer(POSITION_ATTRIBUTE, 3, packed ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    offset += format.positionBytes();
+
+    // Vertex normals
+    if (format.normals)
+    {
+        glEnableVertexAttribArray(NORMAL_ATTRIBUTE);
+        if (packed)
+            glVertexAttribPointer(NORMAL_ATTRIBUTE, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offset);
+        else
+            glVertexAttribPointer(NORMAL_ATTRIBUTE, 3, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+        offset += format.normalBytes();
+    }
+    else
+        glDisableVertexAttribArray(NORMAL_ATTRIBUTE);
+
+    // Vertex texture coords
+    if (format.texCoords)
+    {
+        glEnableVertexAttribArray(TEXCOORD_ATTRIBUTE);
+        glVertexAttribPointer(TEXCOORD_ATTRIBUTE, 2, packed ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    }
+    else
+        glDisableVertexAttribArray(TEXCOORD_ATTRIBUTE);
+}
+
+// Sampler uniforms of a mesh's diffuse textures, spelled out so drawing doesn't build strings
+const char* const TEXTURE_DIFFUSE_UNIFORMS[] =
+{
+    "textureDiffuse0", "textureDiffuse1", "textureDiffuse2", "textureDiffuse3",
+    "textureDiffuse4", "textureDiffuse5", "textureDiffuse6", "textureDiffuse7"
+};
+const unsigned int TEXTURE_DIFFUSE_UNIFORM_COUNT = sizeof(TEXTURE_DIFFUSE_UNIFORMS) / sizeof(TEXTURE_DIFFUSE_UNIFORMS[0]);
+
+// What a mesh keeps on the CPU once its buffers are on the GPU
+enum class GeometryRetention
+{
+    Keep,       // vertices/indices stay resident (needed by anything reading geometry on the CPU)
+    Release     // vertices/indices are freed after upload
 };
 
+// Inputs for picking a LOD from projected size, see Mesh::selectLod
+struct LodSelection
+{
+    bool enabled = false;
+    glm::vec3 cameraPosition = glm::vec3(0.0f);
+    float pixelsPerUnit = 0.0f;         // Pixels covered by one unit at distance one
+    float pixelErrorThreshold = 1.0f;   // Largest acceptable on-screen error of a LOD
+};
+
+// LOD selection for a perspective camera with vertical field of view fovY (degrees, the camera's zoom)
+LodSelection makeLodSelection(const glm::vec3& cameraPosition, float fovY, float viewportHeight, float pixelErrorThreshold)
+{
+    LodSelection selection;
+    selection.enabled = true;
+    selection.cameraPosition = cameraPosition;
+    selection.pixelsPerUnit = viewportHeight / (2.0f * std::tan(glm::radians(fovY) * 0.5f));
+    selection.pixelErrorThreshold = pixelErrorThreshold;
+    return selection;
+}
+
+// Coarsest of lods whose error stays under the pixel threshold for an object with the given
+// bounding sphere drawn with modelMatrix
+unsigned int selectLodLevel(const std::vector<MeshLod>& lods, const glm::vec3& boundsCenter, float boundsRadius,
+    const glm::mat4& modelMatrix, const LodSelection& selection)
+{
+    if (!selection.enabled || lods.size() < 2)
+        return 0;
+
+    // Largest axis scale of the model matrix, errors and radius are in object space
+    const float scale = std::max(glm::length(glm::vec3(modelMatrix[0])),
+        std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+    const glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(boundsCenter, 1.0f));
+    const float distance = glm::length(center - selection.cameraPosition) - boundsRadius * scale;
+    if (distance <= 0.0f)
+        return 0;
+
+    for (unsigned int lod = static_cast<unsigned int>(lods.size()) - 1; lod > 0; lod--)
+    {
+        if (lods[lod].error * scale / distance * selection.pixelsPerUnit <= selection.pixelErrorThreshold)
+            return lod;
+    }
+    return 0;
+}
+
 // Enum for 6 DoF pose indexing
 enum
 {
@@ -46,19 +252,48 @@ public:
     float mesh6DoF[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
     float initRad = 0.0f;
     float initRot = 0.0f;
+    GLsizei indexCount = 0;             // Indices of LOD 0
+    GLenum indexType = GL_UNSIGNED_INT;
+    VertexFormat vertexFormat;
+    GLsizeiptr vertexBufferBytes = 0;
+    GLsizeiptr indexBufferBytes = 0;
+    std::vector<MeshLod> lods;          // Index ranges, finest first
+    glm::vec3 boundsMin = glm::vec3(0.0f);     // Object space AABB
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);  // Bounding sphere
+    float boundsRadius = 0.0f;
 
-    // Init the mesh
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, const std::vector<Texture>& textures)
+    // Init the mesh, pass the arrays as rvalues to hand them over without copying.
+    // indices holds every LOD back to back as described by lods (none means a single level).
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+        GeometryRetention retention = GeometryRetention::Keep, const VertexFormat& format = VertexFormat(),
+        std::vector<MeshLod> lods = std::vector<MeshLod>())
+        : vertices(std::move(vertices))
+        , indices(std::move(indices))
+        , textures(std::move(textures))
+        , vertexFormat(format)
+        , lods(std::move(lods))
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        if (this->lods.empty())
+            this->lods.push_back({ 0, static_cast<unsigned int>(this->indices.size()), 0.0f });
+        indexCount = static_cast<GLsizei>(this->lods[0].indexCount);
+        computeBounds();
         setupMesh();
 
+        if (retention == GeometryRetention::Release)
+            releaseGeometry();
+
         // Init mesh matrix to identity
         this->meshMatrix = glm::mat4(1);
     }
 
+    // Free the CPU copy of the geometry, the GPU buffers stay valid
+    void releaseGeometry()
+    {
+        std::vector<Vertex>().swap(vertices);
+        std::vector<unsigned int>().swap(indices);
+    }
+
     // Update mesh matrix
     void updateModelMatrix()
     {
@@ -69,29 +304,50 @@ public:
         meshMatrix = glm::rotate(meshMatrix, mesh6DoF[rZ], glm::vec3(0.0f, 0.0f, 1.0f));                // Rotate around Z-axis    
     }
 
-    // Draw the mesh
-    void draw(Shader& shader)
+    // Coarsest LOD whose error stays under the pixel threshold when drawn with modelMatrix
+    unsigned int selectLod(const glm::mat4& modelMatrix, const LodSelection& selection) const
+    {
+        return selectLodLevel(lods, boundsCenter, boundsRadius, modelMatrix, selection);
+    }
+
+    // Triangles drawn by a LOD
+    size_t lodTriangles(unsigned int lod) const
+    {
+        return lods[std::min<size_t>(lod, lods.size() - 1)].indexCount / 3;
+    }
+
+    // Index range of a LOD
+    const MeshLod& lodRange(unsigned int lod) const
+    {
+        return lods[std::min<size_t>(lod, lods.size() - 1)];
+    }
+
+    GLuint vertexArray() const
+    {
+        return VAO;
+    }
+
+    // Draw the mesh at the given LOD
+    void draw(Shader& shader, unsigned int lod = 0)
     {
         // If multiple textures for this mesh, loop through
         for (unsigned int i = 0; i < static_cast<unsigned int>(textures.size()); i++)
         {
-            // Active proper texture unit before binding
-            glActiveTexture(GL_TEXTURE0 + i); 
- 
             // Set the sampler to the correct texture unit
-            shader.setInt("textureDiffuse" + std::to_string(i), i);
+            if (i < TEXTURE_DIFFUSE_UNIFORM_COUNT)
+                shader.setInt(TEXTURE_DIFFUSE_UNIFORMS[i], i);
+            else
+                shader.setInt("textureDiffuse" + std::to_string(i), i);
 
-            // Bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            // Bind the texture to unit i (skipped when it already is)
+            GLState::instance().bindTexture(i, GL_TEXTURE_2D, textures[i].id);
         }
 
         // Draw
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // Set active back to 0
-        glActiveTexture(GL_TEXTURE0);
+        const MeshLod& range = lodRange(lod);
+        const size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+        GLState::instance().bindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount), indexType, (void*)(range.indexOffset * indexSize));
     }
 
     // Draw the mesh with hierarchy
@@ -104,23 +360,19 @@ public:
         // If multiple textures for this mesh, loop through
         for (unsigned int i = 0; i < static_cast<unsigned int>(textures.size()); i++)
         {
-            // Active proper texture unit before binding
-            glActiveTexture(GL_TEXTURE0 + i);
-
             // Set the sampler to the correct texture unit
-            shader.setInt("textureDiffuse" + std::to_string(i), i);
+            if (i < TEXTURE_DIFFUSE_UNIFORM_COUNT)
+                shader.setInt(TEXTURE_DIFFUSE_UNIFORMS[i], i);
+            else
+                shader.setInt("textureDiffuse" + std::to_string(i), i);
 
-            // Bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            // Bind the texture to unit i (skipped when it already is)
+            GLState::instance().bindTexture(i, GL_TEXTURE_2D, textures[i].id);
         }
 
         // Draw
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // Set active back to 0
-        glActiveTexture(GL_TEXTURE0);
+        GLState::instance().bindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indexCount, indexType, 0);
 
         // Reset model matrix
         shader.setMat4("model", modelMat);
@@ -129,6 +381,24 @@ public:
 private:
     unsigned int VAO, VBO, EBO;
 
+    // AABB (frustum culling) and bounding sphere around its centre (LOD selection), computed
+    // from the vertices whether they came from the importer or the mesh cache
+    void computeBounds()
+    {
+        if (vertices.empty())
+            return;
+        boundsMin = boundsMax = vertices[0].Position;
+        for (const Vertex& vertex : vertices)
+        {
+            boundsMin = glm::min(boundsMin, vertex.Position);
+            boundsMax = glm::max(boundsMax, vertex.Position);
+        }
+        boundsCenter = (boundsMin + boundsMax) * 0.5f;
+        boundsRadius = 0.0f;
+        for (const Vertex& vertex : vertices)
+            boundsRadius = std::max(boundsRadius, glm::length(vertex.Position - boundsCenter));
+    }
+
     // Setup
     void setupMesh()
     {
@@ -138,27 +408,34 @@ private:
         glGenBuffers(1, &EBO);
 
         // Bind VAO
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        // EBO
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // Vertex positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-
-        // Vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        
-        // Vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-
-        glBindVertexArray(0);
+        GLState::instance().bindVertexArray(VAO);
+        GLState::instance().bindBuffer(GL_ARRAY_BUFFER, VBO);
+        vertexBufferBytes = static_cast<GLsizeiptr>(vertices.size()) * vertexFormat.stride();
+        if (vertexFormat.matchesVertex())
+            glBufferData(GL_ARRAY_BUFFER, vertexBufferBytes, vertices.data(), GL_STATIC_DRAW);
+        else
+            glBufferData(GL_ARRAY_BUFFER, vertexBufferBytes, packVertices(vertices, vertexFormat).data(), GL_STATIC_DRAW);
+
+        // EBO, 16-bit indices whenever every vertex can be addressed with them
+        GLState::instance().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        if (vertices.size() <= 65536)
+        {
+            std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+            indexType = GL_UNSIGNED_SHORT;
+            indexBufferBytes = static_cast<GLsizeiptr>(shortIndices.size() * sizeof(uint16_t));
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferBytes, shortIndices.data(), GL_STATIC_DRAW);
+        }
+        else
+        {
+            indexType = GL_UNSIGNED_INT;
+            indexBufferBytes = static_cast<GLsizeiptr>(indices.size() * sizeof(unsigned int));
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferBytes, indices.data(), GL_STATIC_DRAW);
+        }
+
+        // Vertex attributes in the mesh's format
+        setupVertexAttributes(vertexFormat);
+
+        GLState::instance().bindVertexArray(0);
     }
 };
 #endif
@@ -0,0 +1,226 @@
+#ifndef MY_MESH_CACHE_H
+#define MY_MESH_CACHE_H
+
+#include <my_mapped_file.h>
+#include <my_mesh.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Binary mesh cache, lets a warm start skip the Assimp import entirely.
+// One file per source model, keyed by source path, mtime, size and import flags.
+//
+// Layout (little endian, every block 4-byte aligned):
+//   MeshCacheHeader
+//   source path bytes
+//   per mesh: MeshCacheEntry, name bytes, Vertex[vertexCount], uint32[indexCount],
+//             MeshLod[lodCount], per texture: uint32 length + path bytes
+const char MESH_CACHE_DIR[] = "cache";
+const uint32_t MESH_CACHE_MAGIC = 0x3148534D; // "MSH1"
+const uint32_t MESH_CACHE_VERSION = 4; // 3: meshes are stored welded and optimised (my_mesh_optimizer.h), 4: LOD chains
+
+struct MeshCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t importFlags;
+    uint32_t meshCount;
+    int64_t sourceMTime;
+    uint64_t sourceSize;
+    uint32_t vertexSize;
+    uint32_t pathLength;
+};
+
+struct MeshCacheEntry
+{
+    uint32_t nameLength;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+};
+
+// Cache file location for a source model (cache/models_teapot_smooth.obj.mcache)
+std::string meshCachePath(const std::string& sourcePath)
+{
+    std::string fileName = sourcePath;
+    for (char& c : fileName)
+    {
+        if (c == '/' || c == '\\' || c == ':')
+            c = '_';
+    }
+    return std::string(MESH_CACHE_DIR) + "/" + fileName + ".mcache";
+}
+
+// Round a byte offset up to the next 4-byte boundary
+size_t meshCacheAlign(size_t offset)
+{
+    return (offset + 3) & ~static_cast<size_t>(3);
+}
+
+// Read the cached meshes for sourcePath, returns false on a miss or a stale cache
+bool readMeshCache(const std::string& sourcePath, unsigned int importFlags, std::vector<MeshData>& meshes)
+{
+    int64_t mtime;
+    uint64_t size;
+    if (!fileStamp(sourcePath, mtime, size))
+        return false;
+
+    MappedFile file;
+    if (!file.open(meshCachePath(sourcePath)))
+        return false;
+
+    const unsigned char* base = file.data();
+    const size_t fileSize = file.size();
+    size_t offset = 0;
+
+    // Check the key before touching any mesh data
+    MeshCacheHeader header;
+    if (fileSize < sizeof(header))
+        return false;
+    std::memcpy(&header, base, sizeof(header));
+    offset += sizeof(header);
+
+    if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION ||
+        header.importFlags != importFlags || header.sourceMTime != mtime || header.sourceSize != size ||
+        header.vertexSize != sizeof(Vertex) || header.pathLength != sourcePath.size() ||
+        offset + header.pathLength > fileSize ||
+        std::memcmp(base + offset, sourcePath.data(), header.pathLength) != 0)
+        return false;
+    offset = meshCacheAlign(offset + header.pathLength);
+
+    std::vector<MeshData> cached(header.meshCount);
+    for (MeshData& mesh : cached)
+    {
+        MeshCacheEntry entry;
+        if (offset + sizeof(entry) > fileSize)
+            return false;
+        std::memcpy(&entry, base + offset, sizeof(entry));
+        offset += sizeof(entry);
+
+        // Name
+        if (offset + entry.nameLength > fileSize)
+            return false;
+        mesh.name.assign(reinterpret_cast<const char*>(base + offset), entry.nameLength);
+        offset = meshCacheAlign(offset + entry.nameLength);
+
+        // Vertex and index arrays are stored exactly as they are laid out in memory
+        const size_t vertexBytes = static_cast<size_t>(entry.vertexCount) * sizeof(Vertex);
+        const size_t indexBytes = static_cast<size_t>(entry.indexCount) * sizeof(unsigned int);
+        const size_t lodBytes = static_cast<size_t>(entry.lodCount) * sizeof(MeshLod);
+        if (offset + vertexBytes + indexBytes + lodBytes > fileSize)
+            return false;
+        const Vertex* vertices = reinterpret_cast<const Vertex*>(base + offset);
+        mesh.vertices.assign(vertices, vertices + entry.vertexCount);
+        offset += vertexBytes;
+        const unsigned int* indices = reinterpret_cast<const unsigned int*>(base + offset);
+        mesh.indices.assign(indices, indices + entry.indexCount);
+        offset += indexBytes;
+        const MeshLod* lods = reinterpret_cast<const MeshLod*>(base + offset);
+        mesh.lods.assign(lods, lods + entry.lodCount);
+        offset += lodBytes;
+        for (const MeshLod& lod : mesh.lods)
+        {
+            if (static_cast<size_t>(lod.indexOffset) + lod.indexCount > mesh.indices.size())
+                return false;
+        }
+
+        // Texture paths
+        mesh.texturePaths.resize(entry.textureCount);
+        for (std::string& texturePath : mesh.texturePaths)
+        {
+            uint32_t length;
+            if (offset + sizeof(length) > fileSize)
+                return false;
+            std::memcpy(&length, base + offset, sizeof(length));
+            offset += sizeof(length);
+            if (offset + length > fileSize)
+                return false;
+            texturePath.assign(reinterpret_cast<const char*>(base + offset), length);
+            offset = meshCacheAlign(offset + length);
+        }
+    }
+
+    meshes = std::move(cached);
+    return true;
+}
+
+// Write the meshes for sourcePath to the cache, a failure only costs the next startup
+bool writeMeshCache(const std::string& sourcePath, unsigned int importFlags, const std::vector<MeshData>& meshes)
+{
+    MeshCacheHeader header = {};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.importFlags = importFlags;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    header.vertexSize = sizeof(Vertex);
+    header.pathLength = static_cast<uint32_t>(sourcePath.size());
+    if (!fileStamp(sourcePath, header.sourceMTime, header.sourceSize))
+        return false;
+
+    std::error_code ec;
+    std::filesystem::create_directories(MESH_CACHE_DIR, ec);
+
+    // Write to a temporary file and rename so a reader never sees a half written cache
+    const std::string cachePath = meshCachePath(sourcePath);
+    const std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            std::cout << "ERROR::MESH_CACHE:: Could not write " << tempPath << std::endl;
+            return false;
+        }
+
+        const char padding[4] = { 0, 0, 0, 0 };
+        auto writePadded = [&](const void* data, size_t bytes)
+        {
+            out.write(static_cast<const char*>(data), bytes);
+            out.write(padding, meshCacheAlign(bytes) - bytes);
+        };
+
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writePadded(sourcePath.data(), sourcePath.size());
+
+        for (const MeshData& mesh : meshes)
+        {
+            MeshCacheEntry entry;
+            entry.nameLength = static_cast<uint32_t>(mesh.name.size());
+            entry.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+            entry.indexCount = static_cast<uint32_t>(mesh.indices.size());
+            entry.textureCount = static_cast<uint32_t>(mesh.texturePaths.size());
+            entry.lodCount = static_cast<uint32_t>(mesh.lods.size());
+            out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+            writePadded(mesh.name.data(), mesh.name.size());
+            out.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+            out.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+            out.write(reinterpret_cast<const char*>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLod));
+            for (const std::string& texturePath : mesh.texturePaths)
+            {
+                uint32_t length = static_cast<uint32_t>(texturePath.size());
+                out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+                writePadded(texturePath.data(), texturePath.size());
+            }
+        }
+
+        if (!out)
+        {
+            std::cout << "ERROR::MESH_CACHE:: Failed writing " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+#endif // MY_MESH_CACHE_H
@@ -0,0 +1,403 @@
+#ifndef MY_MESH_OPTIMIZER_H
+#define MY_MESH_OPTIMIZER_H
+
+#include <my_mesh.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Import-time mesh optimisation: vertex welding, triangle/vertex reordering for the
+// post-transform vertex cache (Forsyth), overdraw (cluster sort, Tipsify-style) and
+// vertex fetch locality.
+
+// Size of the simulated FIFO cache used for reporting
+const unsigned int VERTEX_CACHE_REPORT_SIZE = 16;
+
+// Size of the LRU cache the Forsyth scoring models
+const int FORSYTH_CACHE_SIZE = 32;
+
+// Post-transform cache efficiency of an index buffer
+struct VertexCacheStats
+{
+    float acmr = 0.0f; // Average cache miss ratio, vertex shader runs per triangle (0.5 ideal, 3 worst)
+    float atvr = 0.0f; // Average transform to vertex ratio, vertex shader runs per vertex (1 ideal)
+};
+
+// Vertex attributes reduced to integers for welding
+struct WeldKey
+{
+    int32_t values[8];
+
+    bool operator==(const WeldKey& other) const
+    {
+        return std::memcmp(values, other.values, sizeof(values)) == 0;
+    }
+};
+
+struct WeldKeyHash
+{
+    size_t operator()(const WeldKey& key) const
+    {
+        // FNV-1a over the quantised attributes
+        uint64_t hash = 14695981039346656037ull;
+        for (int32_t value : key.values)
+        {
+            hash ^= static_cast<uint32_t>(value);
+            hash *= 1099511628211ull;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+// Quantise one attribute, epsilon 0 keeps the exact float bits
+int32_t weldQuantise(float value, float epsilon)
+{
+    if (epsilon > 0.0f)
+        return static_cast<int32_t>(std::floor(value / epsilon + 0.5f));
+
+    int32_t bits;
+    value += 0.0f; // -0 welds with +0
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Merge vertices whose attributes are identical (or equal after quantising to epsilon) and
+// remap indices to the survivors. The first vertex of each group is kept as is.
+void weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, float epsilon = 0.0f)
+{
+    std::unordered_map<WeldKey, unsigned int, WeldKeyHash> unique;
+    unique.reserve(vertices.size());
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& vertex = vertices[i];
+        const float attributes[8] = { vertex.Position.x, vertex.Position.y, vertex.Position.z,
+            vertex.Normal.x, vertex.Normal.y, vertex.Normal.z, vertex.TexCoords.x, vertex.TexCoords.y };
+        WeldKey key;
+        for (int k = 0; k < 8; k++)
+            key.values[k] = weldQuantise(attributes[k], epsilon);
+
+        auto inserted = unique.emplace(key, static_cast<unsigned int>(result.size()));
+        if (inserted.second)
+            result.push_back(vertex);
+        remap[i] = inserted.first->second;
+    }
+
+    for (unsigned int& index : indices)
+        index = remap[index];
+    vertices.swap(result);
+}
+
+// Simulate a FIFO post-transform cache over indices
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_REPORT_SIZE)
+{
+    VertexCacheStats stats;
+    if (indices.size() < 3 || vertexCount == 0)
+        return stats;
+
+    // A vertex is cached if it was inserted within the last cacheSize misses
+    std::vector<unsigned int> insertedAt(vertexCount, 0);
+    std::vector<char> referenced(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    size_t misses = 0, uniqueVertices = 0;
+    for (unsigned int index : indices)
+    {
+        if (time - insertedAt[index] > cacheSize)
+        {
+            insertedAt[index] = time++;
+            misses++;
+        }
+        if (!referenced[index])
+        {
+            referenced[index] = 1;
+            uniqueVertices++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(uniqueVertices);
+    return stats;
+}
+
+// Forsyth vertex score, higher means the vertex should be used sooner
+float forsythVertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        // The last triangle's vertices get a fixed score so the next one doesn't just reuse them
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+            score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / static_cast<float>(FORSYTH_CACHE_SIZE - 3), 1.5f);
+    }
+
+    // Favour vertices with few triangles left so they don't end up stranded
+    score += 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+    return score;
+}
+
+// Reorder triangles for post-transform vertex cache hits (Tom Forsyth's linear-speed algorithm)
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Vertex to triangle adjacency
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices)
+        remaining[index]++;
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[cursor[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<char> emitted(triangleCount, 0);
+    int best = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        if (triangleScore[t] > triangleScore[best])
+            best = static_cast<int>(t);
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    std::vector<unsigned int> cache, newCache;
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+    size_t scanCursor = 0;
+
+    while (best >= 0)
+    {
+        // Emit the best triangle and drop it from its vertices' adjacency
+        const unsigned int* triangle = &indices[static_cast<size_t>(best) * 3];
+        emitted[best] = 1;
+        for (int k = 0; k < 3; k++)
+        {
+            const unsigned int v = triangle[k];
+            result.push_back(v);
+            unsigned int* begin = &adjacency[offsets[v]];
+            unsigned int* end = begin + remaining[v];
+            unsigned int* found = std::find(begin, end, static_cast<unsigned int>(best));
+            if (found != end)
+            {
+                *found = *(end - 1);
+                remaining[v]--;
+            }
+        }
+
+        // Its vertices move to the front of the LRU cache
+        newCache.assign(triangle, triangle + 3);
+        for (unsigned int v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                newCache.push_back(v);
+        }
+
+        // Rescore everything that was or is in the cache (evicted vertices lose their cache bonus)
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            const unsigned int v = newCache[i];
+            cachePosition[v] = i < static_cast<size_t>(FORSYTH_CACHE_SIZE) ? static_cast<int>(i) : -1;
+            vertexScore[v] = forsythVertexScore(cachePosition[v], remaining[v]);
+        }
+
+        // Next triangle is the best one touching the cache
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : newCache)
+        {
+            for (unsigned int a = offsets[v]; a < offsets[v] + remaining[v]; a++)
+            {
+                const unsigned int t = adjacency[a];
+                triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = static_cast<int>(t);
+                }
+            }
+        }
+
+        if (newCache.size() > static_cast<size_t>(FORSYTH_CACHE_SIZE))
+            newCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(newCache);
+
+        // Nothing connected to the cache left, restart from the next unused triangle
+        if (best < 0)
+        {
+            while (scanCursor < triangleCount && emitted[scanCursor])
+                scanCursor++;
+            if (scanCursor < triangleCount)
+                best = static_cast<int>(scanCursor);
+        }
+    }
+
+    indices.swap(result);
+}
+
+// Reorder clusters of the (already cache optimised) triangle list so outward facing clusters far
+// from the centre are drawn first and occlude the rest. Clusters start wherever the cache
+// simulation restarts (all three vertices miss), so cache efficiency is kept.
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, unsigned int cacheSize = VERTEX_CACHE_REPORT_SIZE)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Split into clusters at hard cache boundaries
+    std::vector<size_t> clusterStarts;
+    std::vector<unsigned int> insertedAt(vertices.size(), 0);
+    unsigned int time = cacheSize + 1;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int misses = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            const unsigned int v = indices[t * 3 + k];
+            if (time - insertedAt[v] > cacheSize)
+            {
+                insertedAt[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3)
+            clusterStarts.push_back(t);
+    }
+    clusterStarts.push_back(triangleCount);
+
+    // Area weighted centroid and normal per cluster
+    const size_t clusterCount = clusterStarts.size() - 1;
+    std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        float clusterArea = 0.0f;
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+        {
+            const glm::vec3& p0 = vertices[indices[t * 3]].Position;
+            const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+            const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            const float area = glm::length(normal);
+            clusterNormal[c] += normal;
+            clusterCentroid[c] += (p0 + p1 + p2) * (area / 3.0f);
+            clusterArea += area;
+        }
+        meshCentroid += clusterCentroid[c];
+        meshArea += clusterArea;
+        if (clusterArea > 0.0f)
+            clusterCentroid[c] /= clusterArea;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    // Sort clusters by how far out they sit along their own facing direction
+    std::vector<float> clusterKey(clusterCount);
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        const float normalLength = glm::length(clusterNormal[c]);
+        clusterKey[c] = normalLength > 0.0f ? glm::dot(clusterCentroid[c] - meshCentroid, clusterNormal[c] / normalLength) : 0.0f;
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return clusterKey[a] > clusterKey[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c : order)
+        result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+    indices.swap(result);
+}
+
+// Renumber vertices in order of first use so vertex fetches walk memory linearly,
+// unreferenced vertices are dropped
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    const unsigned int unmapped = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unmapped);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+    for (unsigned int& index : indices)
+    {
+        if (remap[index] == unmapped)
+        {
+            remap[index] = static_cast<unsigned int>(result.size());
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(result);
+}
+
+// Before/after cache statistics of one optimised mesh
+struct MeshOptimizeReport
+{
+    std::string name;
+    VertexCacheStats before;
+    VertexCacheStats after;
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+
+    std::string toString() const
+    {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(3) << "Mesh '" << name << "' vertices " << verticesBefore << " -> " << verticesAfter
+            << ", ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr;
+        return out.str();
+    }
+};
+
+// Full import-time pass: weld, then vertex cache, overdraw and vertex fetch order
+MeshOptimizeReport optimizeMesh(MeshData& mesh, float weldEpsilon = 0.0f)
+{
+    MeshOptimizeReport report;
+    report.name = mesh.name;
+    report.verticesBefore = mesh.vertices.size();
+    report.before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+
+    weldVertices(mesh.vertices, mesh.indices, weldEpsilon);
+
+    // Only triangle lists can be reordered
+    if (mesh.indices.size() % 3 == 0)
+    {
+        optimizeVertexCache(mesh.indices, mesh.vertices.size());
+        optimizeOverdraw(mesh.indices, mesh.vertices);
+        optimizeVertexFetch(mesh.vertices, mesh.indices);
+    }
+
+    report.verticesAfter = mesh.vertices.size();
+    report.after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    return report;
+}
+#endif // MY_MESH_OPTIMIZER_H
@@ -0,0 +1,321 @@
+#ifndef MY_MESH_SIMPLIFIER_H
+#define MY_MESH_SIMPLIFIER_H
+
+#include <my_mesh.h>
+#include <my_mesh_optimizer.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// Quadric error metric simplification (Garland & Heckbert) with half-edge collapses:
+// a vertex is always collapsed onto one of its neighbours, so every surviving vertex keeps
+// its original position and normal and the LODs can share the full-detail vertex buffer.
+
+// Triangle ratios of the generated LOD levels (relative to LOD 0)
+const float LOD_TRIANGLE_RATIOS[] = { 0.5f, 0.25f, 0.125f };
+
+// Collapses moving a vertex further than this (relative to the mesh radius) are rejected
+const float LOD_MAX_RELATIVE_ERROR = 0.05f;
+
+// Collapses bending a vertex's normal by more than this (cosine) are rejected
+const float LOD_MIN_NORMAL_DOT = 0.8f;
+
+// Symmetric 4x4 plane quadric plus the total area it was built from
+struct Quadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double area = 0;
+
+    // Area weighted plane n.p + d = 0
+    void addPlane(const glm::vec3& n, float d, float weight)
+    {
+        const double x = n.x, y = n.y, z = n.z, w = d;
+        a00 += weight * x * x; a01 += weight * x * y; a02 += weight * x * z; a03 += weight * x * w;
+        a11 += weight * y * y; a12 += weight * y * z; a13 += weight * y * w;
+        a22 += weight * z * z; a23 += weight * z * w;
+        a33 += weight * w * w;
+        area += weight;
+    }
+
+    void add(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        area += q.area;
+    }
+
+    // Area weighted squared distance of p to the planes
+    double evaluate(const glm::vec3& p) const
+    {
+        const double x = p.x, y = p.y, z = p.z;
+        return x * x * a00 + 2 * x * y * a01 + 2 * x * z * a02 + 2 * x * a03
+            + y * y * a11 + 2 * y * z * a12 + 2 * y * a13
+            + z * z * a22 + 2 * z * a23
+            + a33;
+    }
+};
+
+// Simplify a triangle list towards targetIndexCount without moving any vertex further than
+// maxError from the original surface. Returns the new index list (into the same vertices),
+// resultError receives the largest error actually introduced.
+// Border and attribute seam vertices are locked so the silhouette and seams don't open up.
+std::vector<unsigned int> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& sourceIndices,
+    size_t targetIndexCount, float maxError, float* resultError = nullptr)
+{
+    std::vector<unsigned int> indices(sourceIndices);
+    const size_t vertexCount = vertices.size();
+    const size_t triangleCount = indices.size() / 3;
+    if (resultError)
+        *resultError = 0.0f;
+    if (triangleCount == 0 || indices.size() % 3 != 0 || indices.size() <= targetIndexCount)
+        return indices;
+
+    // Plane quadrics and vertex to triangle adjacency
+    std::vector<Quadric> quadrics(vertexCount);
+    std::vector<std::vector<unsigned int>> vertexTriangles(vertexCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& p0 = vertices[indices[t * 3]].Position;
+        const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+        const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        const float doubleArea = glm::length(normal);
+        if (doubleArea > 0.0f)
+        {
+            normal /= doubleArea;
+            for (int k = 0; k < 3; k++)
+                quadrics[indices[t * 3 + k]].addPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5f);
+        }
+        for (int k = 0; k < 3; k++)
+            vertexTriangles[indices[t * 3 + k]].push_back(static_cast<unsigned int>(t));
+    }
+
+    // Lock vertices on open edges (mesh borders and seams where attributes split the surface)
+    std::vector<char> locked(vertexCount, 0);
+    {
+        std::unordered_map<uint64_t, int> edgeUse;
+        edgeUse.reserve(indices.size());
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                const uint64_t a = indices[t * 3 + k], b = indices[t * 3 + (k + 1) % 3];
+                edgeUse[a < b ? (a << 32) | b : (b << 32) | a]++;
+            }
+        }
+        for (const auto& edge : edgeUse)
+        {
+            if (edge.second != 2)
+            {
+                locked[edge.first >> 32] = 1;
+                locked[edge.first & 0xffffffffu] = 1;
+            }
+        }
+    }
+
+    // Candidate collapses, stale entries are recognised by the vertex stamps
+    struct Collapse
+    {
+        double cost;
+        unsigned int from, to;
+        unsigned int fromStamp, toStamp;
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+    std::vector<unsigned int> stamp(vertexCount, 0);
+    std::vector<char> removed(vertexCount, 0);
+    std::vector<char> triangleAlive(triangleCount, 1);
+
+    auto collapseCost = [&](unsigned int from, unsigned int to)
+    {
+        Quadric q = quadrics[from];
+        q.add(quadrics[to]);
+        return q.area > 0.0 ? std::max(q.evaluate(vertices[to].Position), 0.0) / q.area : 0.0;
+    };
+    auto pushCollapse = [&](unsigned int from, unsigned int to)
+    {
+        if (locked[from] || removed[from] || removed[to])
+            return;
+        if (glm::dot(vertices[from].Normal, vertices[to].Normal) < LOD_MIN_NORMAL_DOT)
+            return;
+        heap.push({ collapseCost(from, to), from, to, stamp[from], stamp[to] });
+    };
+
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            const unsigned int a = indices[t * 3 + k], b = indices[t * 3 + (k + 1) % 3];
+            pushCollapse(a, b);
+            pushCollapse(b, a);
+        }
+    }
+
+    // Neighbouring vertices through live triangles
+    std::vector<unsigned int> neighboursFrom, neighboursTo;
+    auto gatherNeighbours = [&](unsigned int v, std::vector<unsigned int>& out)
+    {
+        out.clear();
+        for (unsigned int t : vertexTriangles[v])
+        {
+            if (!triangleAlive[t])
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                const unsigned int w = indices[t * 3 + k];
+                if (w != v && std::find(out.begin(), out.end(), w) == out.end())
+                    out.push_back(w);
+            }
+        }
+    };
+
+    const double maxErrorSq = static_cast<double>(maxError) * maxError;
+    size_t liveTriangles = triangleCount;
+    double worstError = 0.0;
+    while (liveTriangles * 3 > targetIndexCount && !heap.empty())
+    {
+        const Collapse collapse = heap.top();
+        heap.pop();
+        if (removed[collapse.from] || removed[collapse.to] ||
+            collapse.fromStamp != stamp[collapse.from] || collapse.toStamp != stamp[collapse.to])
+            continue;
+        if (collapse.cost > maxErrorSq)
+            break;
+
+        const unsigned int from = collapse.from, to = collapse.to;
+
+        // Link condition, an interior edge shares exactly two neighbours (keeps the mesh manifold)
+        gatherNeighbours(from, neighboursFrom);
+        gatherNeighbours(to, neighboursTo);
+        int shared = 0;
+        for (unsigned int w : neighboursFrom)
+            shared += std::find(neighboursTo.begin(), neighboursTo.end(), w) != neighboursTo.end() ? 1 : 0;
+        if (shared != 2)
+            continue;
+
+        // Reject collapses that flip or badly bend a surviving triangle
+        bool valid = true;
+        for (unsigned int t : vertexTriangles[from])
+        {
+            if (!triangleAlive[t])
+                continue;
+            const unsigned int* tri = &indices[static_cast<size_t>(t) * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to)
+                continue;
+
+            glm::vec3 before[3], after[3];
+            for (int k = 0; k < 3; k++)
+            {
+                before[k] = vertices[tri[k]].Position;
+                after[k] = tri[k] == from ? vertices[to].Position : before[k];
+            }
+            const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            const float lengthBefore = glm::length(normalBefore), lengthAfter = glm::length(normalAfter);
+            if (lengthAfter <= 0.0f || (lengthBefore > 0.0f && glm::dot(normalBefore, normalAfter) < 0.25f * lengthBefore * lengthAfter))
+            {
+                valid = false;
+                break;
+            }
+        }
+        if (!valid)
+            continue;
+
+        // Apply: triangles on the edge die, the rest are moved over to 'to'
+        for (unsigned int t : vertexTriangles[from])
+        {
+            if (!triangleAlive[t])
+                continue;
+            unsigned int* tri = &indices[static_cast<size_t>(t) * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to)
+            {
+                triangleAlive[t] = 0;
+                liveTriangles--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                if (tri[k] == from)
+                    tri[k] = to;
+            }
+            vertexTriangles[to].push_back(t);
+        }
+        vertexTriangles[from].clear();
+        removed[from] = 1;
+        quadrics[to].add(quadrics[from]);
+        stamp[to]++;
+        worstError = std::max(worstError, collapse.cost);
+
+        // Every collapse involving 'to' has a new cost
+        gatherNeighbours(to, neighboursTo);
+        for (unsigned int w : neighboursTo)
+        {
+            pushCollapse(w, to);
+            pushCollapse(to, w);
+        }
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(liveTriangles * 3);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        if (triangleAlive[t])
+            result.insert(result.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+    }
+
+    if (resultError)
+        *resultError = static_cast<float>(std::sqrt(worstError));
+    return result;
+}
+
+// Append a chain of simplified LODs to the mesh's index buffer. LOD 0 is the existing index
+// list, each further level is simplified from the previous one and cache optimised.
+// Levels that can't get meaningfully smaller are dropped.
+void generateLods(MeshData& mesh)
+{
+    const unsigned int baseIndexCount = mesh.lods.empty() ? static_cast<unsigned int>(mesh.indices.size()) : mesh.lods[0].indexCount;
+    mesh.lods.clear();
+    mesh.lods.push_back({ 0, baseIndexCount, 0.0f });
+    if (baseIndexCount % 3 != 0 || mesh.vertices.empty())
+        return;
+
+    // Error bound relative to the mesh size
+    glm::vec3 minPos = mesh.vertices[0].Position, maxPos = mesh.vertices[0].Position;
+    for (const Vertex& vertex : mesh.vertices)
+    {
+        minPos = glm::min(minPos, vertex.Position);
+        maxPos = glm::max(maxPos, vertex.Position);
+    }
+    const float maxError = 0.5f * glm::length(maxPos - minPos) * LOD_MAX_RELATIVE_ERROR;
+
+    std::vector<unsigned int> previous(mesh.indices.begin(), mesh.indices.begin() + baseIndexCount);
+    float previousError = 0.0f;
+    for (float ratio : LOD_TRIANGLE_RATIOS)
+    {
+        const size_t target = static_cast<size_t>(baseIndexCount / 3 * ratio) * 3;
+        float error = 0.0f;
+        std::vector<unsigned int> lod = simplifyMesh(mesh.vertices, previous, target, maxError, &error);
+
+        // Stop once simplification stalls (locked seams, error bound reached)
+        if (lod.empty() || lod.size() > previous.size() * 9 / 10)
+            break;
+
+        optimizeVertexCache(lod, mesh.vertices.size());
+        previousError += error; // Errors stack up along the chain
+        mesh.lods.push_back({ static_cast<unsigned int>(mesh.indices.size()), static_cast<unsigned int>(lod.size()), previousError });
+        mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+        previous.swap(lod);
+    }
+}
+#endif // MY_MESH_SIMPLIFIER_H
@@ -11,18 +11,26 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <my_frustum.h>
 #include <my_mesh.h>
+#include <my_mesh_cache.h>
+#include <my_mesh_optimizer.h>
+#include <my_mesh_simplifier.h>
+#include <my_render_queue.h>
 #include <my_shader.h>
+#include <my_texture_registry.h>
+#include <my_trace.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <utility>
 #include <vector>
 
-// Forward declare
-unsigned int loadTexture(const char* texturePath);
+// Assimp post-processing applied on import, part of the mesh cache key
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
 
 class Model
 {
@@ -30,19 +38,146 @@ public:
     // Public for wall constraints
     std::vector<Mesh> meshes;
 
+    // CPU geometry policy applied to every mesh of this model after upload
+    GeometryRetention retention;
+
+    // GPU vertex format of meshes uploaded from now on
+    VertexFormat vertexFormat;
+
+    // Object space AABB around every mesh
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    // Empty model, filled later through uploadMeshes (see ModelLoader)
+    Model(GeometryRetention retention = GeometryRetention::Keep)
+        : retention(retention)
+    {
+    }
+
     // Constructor (expects a filepath to a 3D model)
-    Model(std::string const& objPath)
+    Model(std::string const& objPath, GeometryRetention retention = GeometryRetention::Keep)
+        : retention(retention)
     {
         loadModel(objPath);
     }
 
+    // Upload meshes in the most compact format providing what shader reads
+    void setVertexFormatFor(const Shader& shader, VertexLayout layout = VertexLayout::Packed)
+    {
+        vertexFormat = selectVertexFormat(shader.activeAttributes(), layout);
+    }
+
+    // Free the CPU geometry of every mesh, e.g. once it has been copied into a SceneBatch
+    void releaseGeometry()
+    {
+        for (Mesh& mesh : meshes)
+            mesh.releaseGeometry();
+    }
+
+    // Bytes of vertex buffer memory used by all meshes
+    size_t vertexBufferBytes() const
+    {
+        size_t bytes = 0;
+        for (const Mesh& mesh : meshes)
+            bytes += static_cast<size_t>(mesh.vertexBufferBytes);
+        return bytes;
+    }
+
+    // Bytes of index buffer memory used by all meshes
+    size_t indexBufferBytes() const
+    {
+        size_t bytes = 0;
+        for (const Mesh& mesh : meshes)
+            bytes += static_cast<size_t>(mesh.indexBufferBytes);
+        return bytes;
+    }
+
+    // Create the GL meshes from loaded mesh data, needs the GL context.
+    // The vertex/index arrays are moved into the meshes, meshData is left empty.
+    void uploadMeshes(std::vector<MeshData>&& meshData)
+    {
+        meshes.reserve(meshes.size() + meshData.size());
+        for (unsigned int i = 0; i < static_cast<unsigned int>(meshData.size()); i++)
+            createMesh(std::move(meshData[i]));
+        meshData.clear();
+    }
+
     // Draw the model (all its meshes)
     void draw(Shader& shader)
     {
+        TRACE_SCOPE("draw", "Model::draw");
         for (unsigned int i = 0; i < static_cast<unsigned int>(meshes.size()); i++)
             meshes[i].draw(shader);
     }
 
+    // Draw the model (all its meshes) with modelMatrix, each mesh at the LOD selection picks and
+    // skipped when culler rejects it. The caller sets the model and normalMatrix uniforms,
+    // returns the triangles drawn
+    size_t draw(Shader& shader, const glm::mat4& modelMatrix, const LodSelection& selection, FrustumCuller* culler = nullptr)
+    {
+        TRACE_SCOPE("draw", "Model::draw");
+        if (culler && !cullModel(*culler, modelMatrix))
+            return 0;
+
+        size_t triangles = 0;
+        for (unsigned int i = 0; i < static_cast<unsigned int>(meshes.size()); i++)
+        {
+            if (culler && !culler->visible(meshes[i].boundsMin, meshes[i].boundsMax, modelMatrix))
+                continue;
+            const unsigned int lod = meshes[i].selectLod(modelMatrix, selection);
+            meshes[i].draw(shader, lod);
+            triangles += meshes[i].lodTriangles(lod);
+        }
+        return triangles;
+    }
+
+    // Queue every mesh for drawing with modelMatrix (set through modelLocation, its normal matrix
+    // through normalMatrixLocation) at the LOD selection picks, sorted into place by the queue.
+    // Meshes culler rejects are left out, the others are drawn only if occlusionQuery (when not 0)
+    // passed samples. Returns the triangles queued
+    size_t submit(RenderQueue& queue, const Shader& shader, GLint modelLocation, GLint normalMatrixLocation,
+        const glm::mat4& modelMatrix, const LodSelection& selection, FrustumCuller* culler = nullptr,
+        GLuint occlusionQuery = 0, RenderLayer layer = RenderLayer::Opaque)
+    {
+        TRACE_SCOPE("draw", "Model::submit");
+        if (culler && !cullModel(*culler, modelMatrix))
+            return 0;
+
+        const uint32_t transform = queue.addTransform(modelMatrix);
+        size_t triangles = 0;
+        for (const Mesh& mesh : meshes)
+        {
+            if (culler && !culler->visible(mesh.boundsMin, mesh.boundsMax, modelMatrix))
+                continue;
+            const MeshLod& range = mesh.lodRange(mesh.selectLod(modelMatrix, selection));
+            RenderCommand command;
+            command.shader = &shader;
+            command.modelLocation = modelLocation;
+            command.normalMatrixLocation = normalMatrixLocation;
+            command.occlusionQuery = occlusionQuery;
+            command.transform = transform;
+            command.vertexArray = mesh.vertexArray();
+            command.indexType = mesh.indexType;
+            command.indexCount = static_cast<GLsizei>(range.indexCount);
+            command.indexOffset = range.indexOffset * (mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int));
+            command.textureCount = static_cast<uint8_t>(std::min<size_t>(mesh.textures.size(), RENDER_COMMAND_TEXTURES));
+            for (unsigned int i = 0; i < command.textureCount; i++)
+                command.textures[i] = mesh.textures[i].id;
+            queue.submit(command, layer, queue.viewDepth(modelMatrix, mesh.boundsCenter));
+            triangles += range.indexCount / 3;
+        }
+        return triangles;
+    }
+
+    // Triangles of the full detail meshes
+    size_t triangleCount() const
+    {
+        size_t triangles = 0;
+        for (const Mesh& mesh : meshes)
+            triangles += mesh.lodTriangles(0);
+        return triangles;
+    }
+
     // Draw the model (all its meshes) hierarchicaly
     void drawHierarchy(Shader& shader, glm::mat4& modelMat, float& rotZ)
     {
@@ -55,45 +190,95 @@ public:
         }
     }
 
-private:
-    // Load a 3D model specified by path
-    void loadModel(std::string const& path)
+    // Load the CPU-side mesh data for a model, from the mesh cache when it's fresh,
+    // otherwise through Assimp (refreshing the cache for the next startup)
+    static bool loadModelData(std::string const& path, std::vector<MeshData>& meshData)
+    {
+        if (readMeshCache(path, MODEL_IMPORT_FLAGS, meshData))
+            return true;
+
+        if (!importModelData(path, meshData))
+            return false;
+
+        writeMeshCache(path, MODEL_IMPORT_FLAGS, meshData);
+        return true;
+    }
+
+    // Full Assimp import of a model followed by the mesh optimisation and LOD generation passes, bypasses the mesh cache
+    static bool importModelData(std::string const& path, std::vector<MeshData>& meshData)
     {
         // Read file
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+
         // Check for errors
         if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
         {
             std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
-            return;
+            return false;
         }
 
         // Process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        meshData.clear();
+        processNode(scene->mRootNode, scene, meshData);
+
+        // Reorder for vertex cache, overdraw and fetch locality, then build the LOD chain
+        // (the cache stores the result)
+        std::ostringstream report;
+        for (unsigned int i = 0; i < static_cast<unsigned int>(meshData.size()); i++)
+        {
+            report << path << ": " << optimizeMesh(meshData[i]).toString() << ", LOD triangles";
+            generateLods(meshData[i]);
+            for (const MeshLod& lod : meshData[i].lods)
+                report << " " << lod.indexCount / 3;
+            report << "\n";
+        }
+        std::cout << report.str() << std::flush;
+        return true;
+    }
+
+private:
+    // Test the whole model first, a model outside the frustum counts all its meshes as culled
+    bool cullModel(FrustumCuller& culler, const glm::mat4& modelMatrix) const
+    {
+        if (!culler.enabled || meshes.size() < 2 || culler.planes().intersects(boundsMin, boundsMax, modelMatrix))
+            return true;
+        culler.cullMeshes(meshes.size());
+        return false;
+    }
+
+    // Load a 3D model specified by path
+    void loadModel(std::string const& path)
+    {
+        std::vector<MeshData> meshData;
+        if (!loadModelData(path, meshData))
+            return;
+
+        uploadMeshes(std::move(meshData));
     }
 
     // Processes a node recursively
-    void processNode(aiNode* node, const aiScene* scene)
+    static void processNode(aiNode* node, const aiScene* scene, std::vector<MeshData>& meshData)
     {
         // Process each mesh located at current node
         for (unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            meshData.emplace_back(processMesh(mesh, scene));
         }
         // Recursively process children nodes
         for (unsigned int i = 0; i < node->mNumChildren; i++)
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, meshData);
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+    static MeshData processMesh(aiMesh* mesh, const aiScene* scene)
     {
         // Data to fill
-        std::vector<Vertex> vertices;
-        std::vector<unsigned int> indices;
-        std::vector<Texture> textures;
+        MeshData data;
+        std::vector<Vertex>& vertices = data.vertices;
+        std::vector<unsigned int>& indices = data.indices;
+        vertices.reserve(mesh->mNumVertices);
+        indices.reserve(static_cast<size_t>(mesh->mNumFaces) * 3);
 
         // Loop through mesh's vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -141,73 +326,51 @@ private:
                 indices.push_back(face.mIndices[j]);
         }
 
-        // Process materials
+        // Process materials, only using diffuse textures
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        
-        // Only using diffuse textures
-        std::vector<Texture> textureMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE);
-        textures.insert(textures.end(), textureMaps.begin(), textureMaps.end());
-
-        // Return a mesh object created from the extracted mesh data
-        Mesh tempMesh(vertices, indices, textures);
+        for (unsigned int i = 0; i < material->GetTextureCount(aiTextureType_DIFFUSE); i++)
+        {
+            aiString str;
+            material->GetTexture(aiTextureType_DIFFUSE, i, &str);
+            data.texturePaths.push_back(str.C_Str());
+        }
 
         // Set name if present
-        std::string meshName = std::string(mesh->mName.C_Str());
-        if (!meshName.empty())
-            tempMesh.meshName = meshName;
+        data.name = std::string(mesh->mName.C_Str());
 
-        return tempMesh;
+        return data;
     }
 
-    // Load materials
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type)
+    // Create the GL mesh (and its textures) in place from imported or cached data
+    void createMesh(MeshData&& data)
+    {
+        meshes.emplace_back(std::move(data.vertices), std::move(data.indices), loadMaterialTextures(data.texturePaths),
+            retention, vertexFormat, std::move(data.lods));
+
+        // Grow the model bounds
+        const Mesh& mesh = meshes.back();
+        boundsMin = meshes.size() == 1 ? mesh.boundsMin : glm::min(boundsMin, mesh.boundsMin);
+        boundsMax = meshes.size() == 1 ? mesh.boundsMax : glm::max(boundsMax, mesh.boundsMax);
+
+        // Set name if present
+        if (!data.name.empty())
+            meshes.back().meshName = std::move(data.name);
+    }
+
+    // Load materials, shared with any mesh or model already using the same file
+    std::vector<Texture> loadMaterialTextures(const std::vector<std::string>& texturePaths)
     {
         std::vector<Texture> textures;
-        for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+        for (unsigned int i = 0; i < static_cast<unsigned int>(texturePaths.size()); i++)
         {
-            aiString str;
-            mat->GetTexture(type, i, &str);
             Texture texture;
-            texture.id = loadTexture(str.C_Str());
-            texture.path = str.C_Str();
+            texture.handle = TextureRegistry::instance().acquire(texturePaths[i]);
+            texture.id = texture.handle->id;
+            texture.path = texturePaths[i];
             textures.push_back(texture);
         }
         return textures;
     }
 };
 
-unsigned int loadTexture(const char* texturePath)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    stbi_set_flip_vertically_on_load(false);
-    int width, height, numChannels;
-    unsigned char* data = stbi_load(texturePath, &width, &height, &numChannels, 0);
-    if (data)
-    {
-        GLenum format = GL_RGB;
-        if (numChannels == 1)
-            format = GL_RED;
-        else if (numChannels == 3)
-            format = GL_RGB;
-        else if (numChannels == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    }
-    else
-        std::cout << "Texture failed to load at path: " << texturePath << std::endl;
-
-    stbi_image_free(data);
-
-    return textureID;
-}
 #endif // MY_MODEL_H
@@ -0,0 +1,110 @@
+#ifndef MY_MODEL_LOADER_H
+#define MY_MODEL_LOADER_H
+
+#include <my_model.h>
+#include <my_thread_pool.h>
+#include <my_trace.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Loads several models at once: import (or cache read) and vertex/index array
+// building run on the worker pool, GL buffer creation stays on the thread that
+// owns the context and is fed by a completion queue.
+class ModelLoader
+{
+public:
+    ModelLoader(ThreadPool& pool)
+        : pool(pool)
+    {
+    }
+
+    // Queue a model for loading, model must outlive finish()
+    void load(Model& model, std::string const& path)
+    {
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            pending++;
+        }
+
+        Model* target = &model;
+        pool.submit([this, target, path]()
+        {
+            Completion completion;
+            completion.model = target;
+            completion.path = path;
+            auto start = std::chrono::steady_clock::now();
+            TRACE_SCOPE_DETAIL("load", "Import model", path);
+            try
+            {
+                completion.loaded = Model::loadModelData(path, completion.meshData);
+            }
+            catch (const std::exception& e)
+            {
+                std::cout << "ERROR::MODEL_LOADER:: " << path << ": " << e.what() << std::endl;
+                completion.loaded = false;
+            }
+            completion.parseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            {
+                std::lock_guard<std::mutex> lock(completionMutex);
+                completions.push_back(std::move(completion));
+            }
+            completionCondition.notify_one();
+        });
+    }
+
+    // Upload each model as soon as its worker is done, returns once all queued models are in GL.
+    // Must be called on the thread owning the GL context.
+    void finish()
+    {
+        for (;;)
+        {
+            Completion completion;
+            {
+                std::unique_lock<std::mutex> lock(completionMutex);
+                completionCondition.wait(lock, [this]() { return pending == 0 || !completions.empty(); });
+                if (completions.empty())
+                    return;
+                completion = std::move(completions.front());
+                completions.pop_front();
+                pending--;
+            }
+
+            if (!completion.loaded)
+            {
+                std::cout << "ERROR::MODEL_LOADER:: Failed to load " << completion.path << std::endl;
+                continue;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            TRACE_SCOPE_DETAIL("load", "Upload model", completion.path);
+            completion.model->uploadMeshes(std::move(completion.meshData));
+            double uploadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Loaded " << completion.path << " (parse " << completion.parseMs << " ms, upload " << uploadMs << " ms)" << std::endl;
+        }
+    }
+
+private:
+    struct Completion
+    {
+        Model* model = nullptr;
+        std::string path;
+        std::vector<MeshData> meshData;
+        bool loaded = false;
+        double parseMs = 0.0;
+    };
+
+    ThreadPool& pool;
+    std::mutex completionMutex;
+    std::condition_variable completionCondition;
+    std::deque<Completion> completions;
+    unsigned int pending = 0;
+};
+#endif // MY_MODEL_LOADER_H
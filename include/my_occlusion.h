@@ -0,0 +1,201 @@
+#ifndef MY_OCCLUSION_H
+#define MY_OCCLUSION_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <my_gl_state.h>
+#include <my_shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Occlusion culling with hardware queries and conditional rendering. Each object's draws are
+// wrapped in glBeginConditionalRender on the query its bounding box proxy issued the frame
+// before, and after the opaque pass the boxes are drawn again (no colour or depth writes) to
+// issue this frame's queries. GL_QUERY_NO_WAIT lets the GPU draw anyway while a result is still
+// in flight, so the CPU never waits on a query. An object coming into view shows up one frame
+// late, the price of never stalling.
+//
+// Only core GL 3.3 features (GL_ANY_SAMPLES_PASSED, conditional render), so it also runs on
+// Mesa llvmpipe.
+
+// Boxes are grown by this fraction (plus OCCLUSION_BOX_MARGIN units) so flat faces of a model
+// lying on its box don't hide the proxy behind the model itself
+const float OCCLUSION_BOX_SCALE = 0.02f;
+const float OCCLUSION_BOX_MARGIN = 0.01f;
+
+// What the previous frame's queries found (only results that were already available are counted)
+struct OcclusionStats
+{
+    size_t tested = 0;
+    size_t occluded = 0;
+};
+
+class OcclusionCuller
+{
+public:
+    bool enabled = false;
+
+    // shader draws the proxies, see shaders/occlusionProxy.vs
+    explicit OcclusionCuller(const Shader& shader)
+        : proxyShader(&shader)
+    {
+        // Unit cube [-1, 1], 8 corners and 12 triangles
+        const float corners[] =
+        {
+            -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f, 1.0f, -1.0f,   -1.0f, 1.0f, -1.0f,
+            -1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f, 1.0f,  1.0f,   -1.0f, 1.0f,  1.0f
+        };
+        const uint8_t triangles[] =
+        {
+            0, 2, 1, 0, 3, 2,   4, 5, 6, 4, 6, 7,   0, 1, 5, 0, 5, 4,
+            3, 6, 2, 3, 7, 6,   0, 4, 7, 0, 7, 3,   1, 2, 6, 1, 6, 5
+        };
+
+        GLState& state = GLState::instance();
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        state.bindVertexArray(VAO);
+        state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(triangles), triangles, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        state.bindVertexArray(0);
+
+        boxUniform = shader.uniform("box");
+    }
+
+    ~OcclusionCuller()
+    {
+        destroy();
+    }
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // Start a frame: this frame's queries go to the other half of every object's pair, the
+    // previous frame's results are counted where they are ready
+    void begin()
+    {
+        current ^= 1;
+        frameStats = OcclusionStats();
+        for (ObjectQueries& object : objects)
+        {
+            object.proxy = false;
+            object.issued[current] = false;
+            if (!object.issued[previous()])
+                continue;
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(object.queries[previous()], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint anySamples = GL_TRUE;
+            glGetQueryObjectuiv(object.queries[previous()], GL_QUERY_RESULT, &anySamples);
+            frameStats.tested++;
+            if (!anySamples)
+                frameStats.occluded++;
+        }
+    }
+
+    // Register object this frame with its object space box and transform. Returns the query its
+    // draws should be conditioned on, 0 to draw unconditionally (culling disabled, no result
+    // from last frame, or the camera inside the box where the proxy can't be trusted)
+    GLuint condition(unsigned int object, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+        const glm::mat4& modelMatrix, const glm::vec3& cameraPosition)
+    {
+        if (!enabled)
+            return 0;
+        if (object >= objects.size())
+            objects.resize(object + 1);
+
+        ObjectQueries& queries = objects[object];
+        if (!queries.queries[0])
+            glGenQueries(2, queries.queries);
+
+        const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        const glm::vec3 extents = (boundsMax - boundsMin) * (0.5f + OCCLUSION_BOX_SCALE) + glm::vec3(OCCLUSION_BOX_MARGIN);
+        queries.box = glm::scale(glm::translate(modelMatrix, center), extents);
+
+        // Camera inside (or nearly inside, the near plane clips the box) the box
+        const glm::vec3 local = glm::vec3(glm::inverse(queries.box) * glm::vec4(cameraPosition, 1.0f));
+        queries.proxy = std::max(std::fabs(local.x), std::max(std::fabs(local.y), std::fabs(local.z))) > 1.1f;
+        return queries.proxy && queries.issued[previous()] ? queries.queries[previous()] : 0;
+    }
+
+    // Issue this frame's queries, after every occluder is in the depth buffer. Leaves the proxy
+    // program and VAO bound
+    void drawProxies()
+    {
+        if (!enabled)
+            return;
+
+        GLState& state = GLState::instance();
+        state.useProgram(proxyShader->ID);
+        state.bindVertexArray(VAO);
+        state.depthMask(GL_FALSE);
+        state.depthFunc(GL_LEQUAL);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        for (ObjectQueries& queries : objects)
+        {
+            if (!queries.proxy)
+                continue;
+            proxyShader->setMat4(boxUniform, queries.box);
+            glBeginQuery(GL_ANY_SAMPLES_PASSED, queries.queries[current]);
+            glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)0);
+            glEndQuery(GL_ANY_SAMPLES_PASSED);
+            queries.issued[current] = true;
+            queries.proxy = false;
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        state.depthFunc(GL_LESS);
+        state.depthMask(GL_TRUE);
+    }
+
+    const OcclusionStats& stats() const { return frameStats; }
+
+    // Delete the GL objects while the context is still current
+    void destroy()
+    {
+        if (!VAO)
+            return;
+        GLState& state = GLState::instance();
+        state.deleteVertexArray(VAO);
+        state.deleteBuffer(VBO);
+        state.deleteBuffer(EBO);
+        for (ObjectQueries& queries : objects)
+        {
+            if (queries.queries[0])
+                glDeleteQueries(2, queries.queries);
+        }
+        objects.clear();
+        VAO = VBO = EBO = 0;
+    }
+
+private:
+    // Two queries per object, one written this frame and one read from the last
+    struct ObjectQueries
+    {
+        GLuint queries[2] = { 0, 0 };
+        bool issued[2] = { false, false };
+        bool proxy = false;             // Box to be drawn this frame
+        glm::mat4 box = glm::mat4(1.0f);
+    };
+
+    const Shader* proxyShader;
+    GLint boxUniform = -1;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    std::vector<ObjectQueries> objects;
+    int current = 0;
+    OcclusionStats frameStats;
+
+    int previous() const { return current ^ 1; }
+};
+#endif // MY_OCCLUSION_H
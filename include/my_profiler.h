@@ -0,0 +1,262 @@
+#ifndef MY_PROFILER_H
+#define MY_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <my_gpu_query.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-pass GPU and CPU timing. A pass is bracketed by two GL_TIMESTAMP queries (timestamps,
+// unlike GL_TIME_ELAPSED, can nest) and two steady_clock readings. Each frame writes one of
+// GPU_QUERY_LATENCY query sets and reads the set back when it comes round again; a frame still
+// in flight then is dropped, never waited for. Finished frames feed a rolling average per pass.
+// Query objects are created on first use, so a profiler can exist before the GL context.
+// Only use from the thread owning the GL context.
+
+// Frames in the rolling averages
+const size_t PROFILER_HISTORY = 120;
+
+// Timings of one named pass, times in milliseconds. A pass begun several times in a frame
+// counts the sum, a frame that skipped it counts zero
+struct PassTiming
+{
+    std::string name;
+    int depth = 0;                  // Nesting level the pass was first seen at
+    std::vector<double> recentGpuMs;    // Ring of the last PROFILER_HISTORY frames
+    std::vector<double> recentCpuMs;
+    size_t cursor = 0;
+    std::vector<double> gpuSamples;     // Every frame, only with GpuProfiler::keepSamples
+    std::vector<double> cpuSamples;
+
+    double averageGpuMs() const { return average(recentGpuMs); }
+    double averageCpuMs() const { return average(recentCpuMs); }
+
+    void add(double gpuMs, double cpuMs, bool keep)
+    {
+        if (recentGpuMs.size() < PROFILER_HISTORY)
+        {
+            recentGpuMs.push_back(gpuMs);
+            recentCpuMs.push_back(cpuMs);
+        }
+        else
+        {
+            recentGpuMs[cursor] = gpuMs;
+            recentCpuMs[cursor] = cpuMs;
+        }
+        cursor = (cursor + 1) % PROFILER_HISTORY;
+        if (keep)
+        {
+            gpuSamples.push_back(gpuMs);
+            cpuSamples.push_back(cpuMs);
+        }
+    }
+
+private:
+    static double average(const std::vector<double>& values)
+    {
+        double sum = 0.0;
+        for (double value : values)
+            sum += value;
+        return values.empty() ? 0.0 : sum / static_cast<double>(values.size());
+    }
+};
+
+class GpuProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    bool enabled = true;
+    bool keepSamples = false;       // Keep every frame's times (benchmarks), not only the rolling window
+
+    ~GpuProfiler()
+    {
+        destroy();
+    }
+
+    // Start a frame, collecting the frame that last used this query set
+    void beginFrame()
+    {
+        FrameQueries& frame = frames[next];
+        if (frame.pending)
+        {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+                collect(frame);
+            else
+                dropped++;
+            frame.pending = false;
+        }
+        frame.used = 0;
+        frame.records.clear();
+        open.clear();
+        recording = enabled;
+    }
+
+    // Close the frame, its results arrive GPU_QUERY_LATENCY frames later
+    void endFrame()
+    {
+        while (!open.empty())
+            endPass();
+        if (!recording)
+            return;
+        FrameQueries& frame = frames[next];
+        frame.pending = frame.used > 0;
+        next = (next + 1) % GPU_QUERY_LATENCY;
+        recording = false;
+    }
+
+    // Passes nest, each endPass closes the innermost open one
+    void beginPass(const char* name)
+    {
+        if (!recording)
+            return;
+        FrameQueries& frame = frames[next];
+        PassRecord record;
+        record.pass = passIndex(name, static_cast<int>(open.size()));
+        record.beginQuery = timestamp(frame);
+        record.cpuStart = Clock::now();
+        open.push_back(frame.records.size());
+        frame.records.push_back(record);
+    }
+
+    void endPass()
+    {
+        if (!recording || open.empty())
+            return;
+        FrameQueries& frame = frames[next];
+        PassRecord& record = frame.records[open.back()];
+        open.pop_back();
+        record.cpuMs = std::chrono::duration<double, std::milli>(Clock::now() - record.cpuStart).count();
+        record.endQuery = timestamp(frame);
+    }
+
+    // Wait for every frame in flight, for benchmarks that want all of them
+    void finish()
+    {
+        for (int i = 0; i < GPU_QUERY_LATENCY; i++)
+        {
+            FrameQueries& frame = frames[(next + i) % GPU_QUERY_LATENCY];
+            if (frame.pending)
+                collect(frame);
+            frame.pending = false;
+        }
+    }
+
+    // Passes in the order they were first seen
+    const std::vector<PassTiming>& passes() const { return timings; }
+
+    // Frames whose queries weren't ready when their set was reused
+    uint64_t droppedFrames() const { return dropped; }
+
+    // Delete the queries while the GL context is still current
+    void destroy()
+    {
+        for (FrameQueries& frame : frames)
+        {
+            if (!frame.queries.empty())
+                glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+            frame.queries.clear();
+            frame.records.clear();
+            frame.used = 0;
+            frame.pending = false;
+        }
+    }
+
+private:
+    struct PassRecord
+    {
+        int pass = 0;
+        size_t beginQuery = 0;
+        size_t endQuery = 0;
+        Clock::time_point cpuStart;
+        double cpuMs = 0.0;
+    };
+
+    // One frame's timestamp queries (grown to the most a frame has needed) and passes
+    struct FrameQueries
+    {
+        std::vector<GLuint> queries;
+        size_t used = 0;
+        std::vector<PassRecord> records;
+        bool pending = false;
+    };
+
+    FrameQueries frames[GPU_QUERY_LATENCY];
+    int next = 0;
+    bool recording = false;
+    std::vector<size_t> open;       // Records of the passes begun and not yet ended
+    std::vector<PassTiming> timings;
+    std::vector<double> frameGpuMs, frameCpuMs;
+    uint64_t dropped = 0;
+
+    int passIndex(const char* name, int depth)
+    {
+        for (size_t i = 0; i < timings.size(); i++)
+        {
+            if (timings[i].name == name)
+                return static_cast<int>(i);
+        }
+        PassTiming timing;
+        timing.name = name;
+        timing.depth = depth;
+        timings.push_back(timing);
+        return static_cast<int>(timings.size() - 1);
+    }
+
+    size_t timestamp(FrameQueries& frame)
+    {
+        if (frame.used == frame.queries.size())
+        {
+            GLuint query = 0;
+            glGenQueries(1, &query);
+            frame.queries.push_back(query);
+        }
+        glQueryCounter(frame.queries[frame.used], GL_TIMESTAMP);
+        return frame.used++;
+    }
+
+    void collect(const FrameQueries& frame)
+    {
+        frameGpuMs.assign(timings.size(), 0.0);
+        frameCpuMs.assign(timings.size(), 0.0);
+        for (const PassRecord& record : frame.records)
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame.queries[record.beginQuery], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.queries[record.endQuery], GL_QUERY_RESULT, &end);
+            frameGpuMs[record.pass] += end > begin ? static_cast<double>(end - begin) / 1.0e6 : 0.0;
+            frameCpuMs[record.pass] += record.cpuMs;
+        }
+        for (size_t i = 0; i < timings.size(); i++)
+            timings[i].add(frameGpuMs[i], frameCpuMs[i], keepSamples);
+    }
+};
+
+// Times the enclosing scope as a pass
+class ProfileScope
+{
+public:
+    ProfileScope(GpuProfiler& profiler, const char* name)
+        : profiler(profiler)
+    {
+        profiler.beginPass(name);
+    }
+
+    ~ProfileScope()
+    {
+        profiler.endPass();
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    GpuProfiler& profiler;
+};
+#endif // MY_PROFILER_H
@@ -0,0 +1,230 @@
+#ifndef MY_RENDER_QUEUE_H
+#define MY_RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <my_gl_state.h>
+#include <my_mesh.h>
+#include <my_shader.h>
+#include <my_uniform_buffers.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Per-frame queue of draw commands. Submission only records compact commands, execute() sorts
+// them by a 64-bit key and replays them, so draws sharing a program, textures or VAO end up
+// next to each other whatever order they were submitted in.
+//
+// Key layout, most significant first:
+//   63..60 layer      opaque before sky before transparent
+//   59..52 program    compact id of the program
+//   51..40 material   compact id of the first texture (0 for none)
+//   39..16 depth      view depth, front to back (back to front for transparent)
+//   15..0  VAO        compact id of the vertex array
+// Depth ranks above the VAO: the refraction shader is fragment heavy, early-z rejects
+// are worth more than the odd extra VAO bind.
+
+const int RENDER_COMMAND_TEXTURES = 4;
+
+enum class RenderLayer : uint8_t
+{
+    Opaque = 0,
+    Sky = 1,
+    Transparent = 2
+};
+
+struct RenderCommand
+{
+    uint64_t key = 0;
+    const Shader* shader = nullptr;
+    GLint modelLocation = -1;       // Where the transform goes, -1 for none
+    GLint normalMatrixLocation = -1;    // Where its normal matrix goes, -1 for none
+    uint32_t transform = 0;         // Index into the queue's transforms
+    GLuint vertexArray = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLsizei indexCount = 0;
+    size_t indexOffset = 0;         // Bytes into the index buffer
+    uint8_t textureCount = 0;
+    GLuint textures[RENDER_COMMAND_TEXTURES] = {};
+    GLuint occlusionQuery = 0;      // Draw only if this query passed samples (see my_occlusion.h), 0 for always
+};
+
+// What the last execute() submitted to GL
+struct RenderQueueStats
+{
+    size_t commands = 0;
+    size_t triangles = 0;
+    size_t programChanges = 0;
+    size_t vertexArrayChanges = 0;
+    size_t textureChanges = 0;
+};
+
+class RenderQueue
+{
+public:
+    // Start a frame, depth keys are computed with view and quantised over [0, farPlane]
+    void begin(const glm::mat4& view, float farPlane = 1000.0f)
+    {
+        viewMatrix = view;
+        depthScale = static_cast<float>(DEPTH_MAX) / farPlane;
+        commands.clear();
+        transforms.clear();
+        normalMatrices.clear();
+    }
+
+    // Store a transform for commands to refer to, its normal matrix is computed once here
+    uint32_t addTransform(const glm::mat4& transform)
+    {
+        transforms.push_back(transform);
+        normalMatrices.push_back(normalMatrix(transform));
+        return static_cast<uint32_t>(transforms.size()) - 1;
+    }
+
+    const glm::mat4& transform(uint32_t index) const
+    {
+        return transforms[index];
+    }
+
+    // Distance in front of the camera of a point in object space
+    float viewDepth(const glm::mat4& modelMatrix, const glm::vec3& point) const
+    {
+        return -(viewMatrix * modelMatrix * glm::vec4(point, 1.0f)).z;
+    }
+
+    // Record a draw, the key is built here
+    void submit(RenderCommand command, RenderLayer layer, float viewDepth)
+    {
+        uint64_t depth = static_cast<uint64_t>(std::min(std::max(viewDepth * depthScale, 0.0f), static_cast<float>(DEPTH_MAX)));
+        if (layer == RenderLayer::Transparent)
+            depth = DEPTH_MAX - depth;
+
+        command.key = (static_cast<uint64_t>(layer) << 60)
+            | (static_cast<uint64_t>(compactId(programIds, command.shader ? command.shader->ID : 0, 0xff)) << 52)
+            | (static_cast<uint64_t>(compactId(textureIds, command.textureCount ? command.textures[0] : 0, 0xfff)) << 40)
+            | (depth << 16)
+            | static_cast<uint64_t>(compactId(vertexArrayIds, command.vertexArray, 0xffff));
+        commands.push_back(command);
+    }
+
+    // Sort and draw everything submitted since begin()
+    void execute()
+    {
+        sortCommands();
+
+        frameStats = RenderQueueStats();
+        frameStats.commands = commands.size();
+        GLState& state = GLState::instance();
+        const Shader* currentShader = nullptr;
+        GLuint currentVertexArray = 0;
+        GLuint currentTextures[RENDER_COMMAND_TEXTURES] = {};
+        for (uint32_t index : order)
+        {
+            const RenderCommand& command = commands[index];
+            if (command.shader != currentShader)
+            {
+                state.useProgram(command.shader->ID);
+                // Units are fixed per slot, so the samplers only need setting when the program changes
+                for (unsigned int i = 0; i < RENDER_COMMAND_TEXTURES && i < TEXTURE_DIFFUSE_UNIFORM_COUNT; i++)
+                    command.shader->setInt(TEXTURE_DIFFUSE_UNIFORMS[i], static_cast<int>(i));
+                currentShader = command.shader;
+                frameStats.programChanges++;
+            }
+            for (unsigned int i = 0; i < command.textureCount; i++)
+            {
+                if (command.textures[i] != currentTextures[i])
+                {
+                    state.bindTexture(i, GL_TEXTURE_2D, command.textures[i]);
+                    currentTextures[i] = command.textures[i];
+                    frameStats.textureChanges++;
+                }
+            }
+            if (command.vertexArray != currentVertexArray)
+            {
+                state.bindVertexArray(command.vertexArray);
+                currentVertexArray = command.vertexArray;
+                frameStats.vertexArrayChanges++;
+            }
+            if (command.modelLocation >= 0)
+                command.shader->setMat4(command.modelLocation, transforms[command.transform]);
+            if (command.normalMatrixLocation >= 0)
+                command.shader->setMat3(command.normalMatrixLocation, normalMatrices[command.transform]);
+
+            if (command.occlusionQuery)
+                glBeginConditionalRender(command.occlusionQuery, GL_QUERY_NO_WAIT);
+            glDrawElements(GL_TRIANGLES, command.indexCount, command.indexType, (void*)command.indexOffset);
+            if (command.occlusionQuery)
+                glEndConditionalRender();
+            frameStats.triangles += command.indexCount / 3;
+        }
+    }
+
+    const RenderQueueStats& stats() const { return frameStats; }
+
+private:
+    static const uint64_t DEPTH_MAX = (1u << 24) - 1;
+
+    glm::mat4 viewMatrix = glm::mat4(1.0f);
+    float depthScale = 1.0f;
+    std::vector<RenderCommand> commands;
+    std::vector<glm::mat4> transforms;
+    std::vector<glm::mat3> normalMatrices;
+    std::vector<uint32_t> order;
+    std::vector<std::pair<uint64_t, uint32_t>> sortItems, sortScratch;
+    RenderQueueStats frameStats;
+
+    // GL names mapped to small dense ids, kept across frames so keys stay stable
+    std::unordered_map<GLuint, uint32_t> programIds;
+    std::unordered_map<GLuint, uint32_t> textureIds;
+    std::unordered_map<GLuint, uint32_t> vertexArrayIds;
+
+    // Dense id of name, ids past maxId share the last value (still sorted, just less grouped)
+    static uint32_t compactId(std::unordered_map<GLuint, uint32_t>& ids, GLuint name, uint32_t maxId)
+    {
+        if (name == 0)
+            return 0;
+        auto found = ids.find(name);
+        if (found == ids.end())
+            found = ids.emplace(name, static_cast<uint32_t>(ids.size()) + 1).first;
+        return std::min(found->second, maxId);
+    }
+
+    // LSD radix sort of the keys, 8 bits per pass, passes where every key has the same byte are skipped
+    void sortCommands()
+    {
+        const size_t count = commands.size();
+        sortItems.resize(count);
+        sortScratch.resize(count);
+        for (size_t i = 0; i < count; i++)
+            sortItems[i] = { commands[i].key, static_cast<uint32_t>(i) };
+
+        for (int shift = 0; shift < 64; shift += 8)
+        {
+            size_t histogram[256] = {};
+            for (const auto& item : sortItems)
+                histogram[(item.first >> shift) & 0xff]++;
+            if (histogram[(sortItems.empty() ? 0 : sortItems[0].first >> shift) & 0xff] == count)
+                continue;
+
+            size_t offset = 0;
+            for (size_t& bucket : histogram)
+            {
+                const size_t bucketSize = bucket;
+                bucket = offset;
+                offset += bucketSize;
+            }
+            for (const auto& item : sortItems)
+                sortScratch[histogram[(item.first >> shift) & 0xff]++] = item;
+            sortItems.swap(sortScratch);
+        }
+
+        order.resize(count);
+        for (size_t i = 0; i < count; i++)
+            order[i] = sortItems[i].second;
+    }
+};
+#endif // MY_RENDER_QUEUE_H
@@ -0,0 +1,340 @@
+#ifndef MY_SCENE_BATCH_H
+#define MY_SCENE_BATCH_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <my_frustum.h>
+#include <my_gl_state.h>
+#include <my_mesh.h>
+#include <my_model.h>
+#include <my_shader.h>
+#include <my_uniform_buffers.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Scene batching: the meshes of every model share one vertex and one index buffer (meshes
+// keep their own indices, placed with a base vertex), objects are (model, transform) pairs
+// and a whole pass is a single multi-draw. Per-object transforms and normal matrices live in a
+// buffer texture indexed by the draw's object index, delivered through an instanced attribute.
+//
+// GL 4.3+: one glMultiDrawElementsIndirect, baseInstance selects each draw's object index.
+// GL 3.3: there is no base instance and no gl_DrawID, so a multi-draw can't tell its draws
+// apart. The fallback walks the same command list with glDrawElementsBaseVertex, feeding the
+// object index as a constant attribute value (no uniform updates, no VAO switches).
+
+// Vertex attribute carrying the object index of a draw, see shaders/refractionBatch.vs
+const GLuint DRAW_INDEX_ATTRIBUTE = 3;
+
+// Texture unit of the transform buffer texture (the skybox uses unit 0)
+const GLint SCENE_BATCH_TRANSFORM_UNIT = 1;
+
+// RGBA32F texels per object: the model matrix columns, then the normal matrix columns
+const int SCENE_BATCH_OBJECT_TEXELS = 4 + 3;
+
+// Layout fixed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+class SceneBatch
+{
+public:
+    // Vertices are uploaded in format, pick it for the shader that draws the batch
+    explicit SceneBatch(const VertexFormat& format = VertexFormat())
+        : vertexFormat(format)
+    {
+    }
+
+    ~SceneBatch()
+    {
+        destroy();
+    }
+
+    SceneBatch(const SceneBatch&) = delete;
+    SceneBatch& operator=(const SceneBatch&) = delete;
+
+    // Add a model's geometry (needs its CPU arrays, load it with GeometryRetention::Keep),
+    // returns the id used by addObject. Textures are not batched.
+    unsigned int addModel(const Model& model)
+    {
+        BatchModel batchModel;
+        batchModel.firstMesh = static_cast<unsigned int>(meshes.size());
+        for (const Mesh& mesh : model.meshes)
+        {
+            if (mesh.vertices.empty())
+            {
+                std::cout << "ERROR::SCENE_BATCH:: Mesh " << mesh.meshName << " has no CPU geometry, keep it to batch it" << std::endl;
+                continue;
+            }
+
+            BatchMesh batchMesh;
+            batchMesh.baseVertex = static_cast<GLint>(vertices.size());
+            batchMesh.boundsMin = mesh.boundsMin;
+            batchMesh.boundsMax = mesh.boundsMax;
+            batchMesh.boundsCenter = mesh.boundsCenter;
+            batchMesh.boundsRadius = mesh.boundsRadius;
+            batchMesh.lods = mesh.lods;
+            for (MeshLod& lod : batchMesh.lods)
+                lod.indexOffset += static_cast<unsigned int>(indices.size());
+
+            vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+            indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+            largestMesh = std::max(largestMesh, mesh.vertices.size());
+            meshes.push_back(batchMesh);
+        }
+        batchModel.meshCount = static_cast<unsigned int>(meshes.size()) - batchModel.firstMesh;
+        models.push_back(batchModel);
+        return static_cast<unsigned int>(models.size()) - 1;
+    }
+
+    // Place an instance of a model, returns the object index
+    unsigned int addObject(unsigned int model, const glm::mat4& transform = glm::mat4(1.0f))
+    {
+        objects.push_back({ model, transform });
+        transformsDirty = true;
+        return static_cast<unsigned int>(objects.size()) - 1;
+    }
+
+    void setTransform(unsigned int object, const glm::mat4& transform)
+    {
+        objects[object].transform = transform;
+        transformsDirty = true;
+    }
+
+    // Remove every object, the geometry stays
+    void clearObjects()
+    {
+        objects.clear();
+        transformsDirty = true;
+    }
+
+    // Create the GL buffers from the added models, the CPU copies are dropped
+    void upload()
+    {
+        indirectDraws = GLAD_GL_VERSION_4_3 != 0;
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glGenBuffers(1, &objectIndexBuffer);
+        glGenBuffers(1, &transformBuffer);
+        glGenTextures(1, &transformTexture);
+        if (indirectDraws)
+            glGenBuffers(1, &indirectBuffer);
+
+        GLState& state = GLState::instance();
+        state.bindVertexArray(VAO);
+        state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        vertexBufferBytes = static_cast<GLsizeiptr>(vertices.size()) * vertexFormat.stride();
+        if (vertexFormat.matchesVertex())
+            glBufferData(GL_ARRAY_BUFFER, vertexBufferBytes, vertices.data(), GL_STATIC_DRAW);
+        else
+            glBufferData(GL_ARRAY_BUFFER, vertexBufferBytes, packVertices(vertices, vertexFormat).data(), GL_STATIC_DRAW);
+        setupVertexAttributes(vertexFormat);
+
+        // Indices are relative to each mesh's base vertex, so 16 bits do as long as every mesh fits
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        if (largestMesh <= 65536)
+        {
+            std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+            indexType = GL_UNSIGNED_SHORT;
+            indexBufferBytes = static_cast<GLsizeiptr>(shortIndices.size() * sizeof(uint16_t));
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferBytes, shortIndices.data(), GL_STATIC_DRAW);
+        }
+        else
+        {
+            indexType = GL_UNSIGNED_INT;
+            indexBufferBytes = static_cast<GLsizeiptr>(indices.size() * sizeof(unsigned int));
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferBytes, indices.data(), GL_STATIC_DRAW);
+        }
+
+        // Object index per draw, one instance per draw so baseInstance picks the element.
+        // Without indirect draws the array stays disabled and the current attribute value is used
+        state.bindBuffer(GL_ARRAY_BUFFER, objectIndexBuffer);
+        glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE, 1);
+        if (indirectDraws)
+            glEnableVertexAttribArray(DRAW_INDEX_ATTRIBUTE);
+        else
+            glDisableVertexAttribArray(DRAW_INDEX_ATTRIBUTE);
+
+        state.bindVertexArray(0);
+
+        // Transforms, SCENE_BATCH_OBJECT_TEXELS RGBA32F texels per object
+        state.bindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+        state.bindTexture(SCENE_BATCH_TRANSFORM_UNIT, GL_TEXTURE_BUFFER, transformTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, transformBuffer);
+        transformsDirty = true;
+
+        std::vector<Vertex>().swap(vertices);
+        std::vector<unsigned int>().swap(indices);
+    }
+
+    // Point a program's transform sampler at the batch's texture unit
+    void bindShader(Shader& shader) const
+    {
+        shader.use();
+        shader.setInt("transforms", SCENE_BATCH_TRANSFORM_UNIT);
+    }
+
+    // Draw every object with the bound program (see shaders/refractionBatch.vs), each mesh
+    // at the LOD selection picks, leaving out meshes culler rejects. Returns the triangles drawn
+    size_t draw(const LodSelection& selection = LodSelection(), FrustumCuller* culler = nullptr)
+    {
+        if (!VAO || objects.empty())
+            return 0;
+
+        if (transformsDirty)
+            uploadTransforms();
+
+        // One command per object mesh, the object index goes through baseInstance
+        commands.clear();
+        commandObjects.clear();
+        size_t triangles = 0;
+        for (unsigned int object = 0; object < static_cast<unsigned int>(objects.size()); object++)
+        {
+            const BatchModel& model = models[objects[object].model];
+            for (unsigned int i = 0; i < model.meshCount; i++)
+            {
+                const BatchMesh& mesh = meshes[model.firstMesh + i];
+                if (culler && !culler->visible(mesh.boundsMin, mesh.boundsMax, objects[object].transform))
+                    continue;
+                const MeshLod& lod = mesh.lods[selectLodLevel(mesh.lods, mesh.boundsCenter, mesh.boundsRadius,
+                    objects[object].transform, selection)];
+                DrawElementsIndirectCommand command;
+                command.count = lod.indexCount;
+                command.instanceCount = 1;
+                command.firstIndex = lod.indexOffset;
+                command.baseVertex = mesh.baseVertex;
+                command.baseInstance = static_cast<GLuint>(commands.size());
+                commands.push_back(command);
+                commandObjects.push_back(object);
+                triangles += lod.indexCount / 3;
+            }
+        }
+        if (commands.empty())
+            return 0;
+
+        GLState& state = GLState::instance();
+        state.bindTexture(SCENE_BATCH_TRANSFORM_UNIT, GL_TEXTURE_BUFFER, transformTexture);
+        state.bindVertexArray(VAO);
+
+        if (indirectDraws)
+        {
+            // Orphan and refill, the previous frame's commands may still be in flight
+            state.bindBuffer(GL_ARRAY_BUFFER, objectIndexBuffer);
+            glBufferData(GL_ARRAY_BUFFER, commandObjects.size() * sizeof(GLuint), commandObjects.data(), GL_STREAM_DRAW);
+            state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)0, static_cast<GLsizei>(commands.size()), 0);
+        }
+        else
+        {
+            const size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+            for (size_t i = 0; i < commands.size(); i++)
+            {
+                glVertexAttribI1ui(DRAW_INDEX_ATTRIBUTE, commandObjects[i]);
+                glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(commands[i].count), indexType,
+                    (void*)(commands[i].firstIndex * indexSize), commands[i].baseVertex);
+            }
+        }
+
+        return triangles;
+    }
+
+    // Delete the GL objects while the context is still current
+    void destroy()
+    {
+        if (!VAO)
+            return;
+        GLState& state = GLState::instance();
+        state.deleteVertexArray(VAO);
+        state.deleteBuffer(VBO);
+        state.deleteBuffer(EBO);
+        state.deleteBuffer(objectIndexBuffer);
+        state.deleteBuffer(transformBuffer);
+        state.deleteTexture(transformTexture);
+        if (indirectBuffer)
+            state.deleteBuffer(indirectBuffer);
+        VAO = VBO = EBO = objectIndexBuffer = transformBuffer = transformTexture = indirectBuffer = 0;
+    }
+
+    // Whether draw() issues a single glMultiDrawElementsIndirect
+    bool usesIndirectDraws() const { return indirectDraws; }
+
+    // Draw calls the last draw() submitted (one per object mesh)
+    size_t drawCount() const { return commands.size(); }
+
+    size_t objectCount() const { return objects.size(); }
+    size_t vertexBytes() const { return static_cast<size_t>(vertexBufferBytes); }
+    size_t indexBytes() const { return static_cast<size_t>(indexBufferBytes); }
+
+private:
+    struct BatchMesh
+    {
+        GLint baseVertex = 0;
+        std::vector<MeshLod> lods;      // indexOffset is into the shared index buffer
+        glm::vec3 boundsMin = glm::vec3(0.0f);
+        glm::vec3 boundsMax = glm::vec3(0.0f);
+        glm::vec3 boundsCenter = glm::vec3(0.0f);
+        float boundsRadius = 0.0f;
+    };
+
+    struct BatchModel
+    {
+        unsigned int firstMesh = 0;
+        unsigned int meshCount = 0;
+    };
+
+    struct BatchObject
+    {
+        unsigned int model;
+        glm::mat4 transform;
+    };
+
+    VertexFormat vertexFormat;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    size_t largestMesh = 0;
+    std::vector<BatchMesh> meshes;
+    std::vector<BatchModel> models;
+    std::vector<BatchObject> objects;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<GLuint> commandObjects;
+    bool transformsDirty = true;
+    bool indirectDraws = false;
+
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    unsigned int objectIndexBuffer = 0, transformBuffer = 0, transformTexture = 0, indirectBuffer = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    GLsizeiptr vertexBufferBytes = 0;
+    GLsizeiptr indexBufferBytes = 0;
+
+    void uploadTransforms()
+    {
+        std::vector<glm::vec4> texels;
+        texels.reserve(objects.size() * SCENE_BATCH_OBJECT_TEXELS);
+        for (const BatchObject& object : objects)
+        {
+            for (int column = 0; column < 4; column++)
+                texels.push_back(object.transform[column]);
+            const glm::mat3 normal = normalMatrix(object.transform);
+            for (int column = 0; column < 3; column++)
+                texels.push_back(glm::vec4(normal[column], 0.0f));
+        }
+        GLState::instance().bindBuffer(GL_TEXTURE_BUFFER, transformBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4), texels.data(), GL_STREAM_DRAW);
+        transformsDirty = false;
+    }
+};
+#endif // MY_SCENE_BATCH_H
@@ -4,10 +4,26 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <my_gl_state.h>
+#include <my_trace.h>
+
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <utility>
+#include <vector>
+
+// FNV-1a hash of a uniform name, the key of Shader's location table
+uint32_t hashUniformName(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    for (; *name; name++)
+        hash = (hash ^ static_cast<unsigned char>(*name)) * 16777619u;
+    return hash;
+}
 
 class Shader
 {
@@ -16,6 +32,7 @@ public:
 
     Shader(const char* vertexPath, const char* fragmentPath)
     {
+        TRACE_SCOPE_DETAIL("load", "Compile shader", vertexPath);
         std::string vertexCode;
         std::string fragmentCode;
         std::ifstream vShaderFile;
@@ -77,75 +94,318 @@ public:
         // Delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+
+        // Record which attribute locations the program actually reads
+        findActiveAttributes();
+
+        // Resolve every uniform location once
+        findActiveUniforms();
+    }
+
+    // Bit mask of the vertex attribute locations the program reads
+    unsigned int activeAttributes() const
+    {
+        return activeAttributeMask;
     }
 
     // Activates the shader
     void use()
     {
-        glUseProgram(ID);
+        GLState::instance().useProgram(ID);
+    }
+
+    // Location of a uniform from the table built at link time, -1 if the program doesn't use it
+    // (setting -1 is a no-op, same as glGetUniformLocation). Resolve once and keep the result
+    // as a handle for the per-frame setters.
+    GLint uniform(const char* name) const
+    {
+        if (uniformSlots.empty())
+            return -1;
+        const uint32_t hash = hashUniformName(name);
+        const size_t mask = uniformSlots.size() - 1;
+        for (size_t i = hash & mask; !uniformSlots[i].name.empty(); i = (i + 1) & mask)
+        {
+            if (uniformSlots[i].hash == hash && std::strcmp(uniformSlots[i].name.c_str(), name) == 0)
+                return uniformSlots[i].location;
+        }
+        return -1;
+    }
+
+    GLint uniform(const std::string& name) const
+    {
+        return uniform(name.c_str());
+    }
+
+    // Number of uniform locations in the table
+    size_t uniformCount() const
+    {
+        return uniformTotal;
+    }
+
+    // Point a uniform block at a binding point, returns false if the program has no such block
+    bool bindUniformBlock(const char* blockName, GLuint binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, blockName);
+        if (index == GL_INVALID_INDEX)
+            return false;
+        glUniformBlockBinding(ID, index, binding);
+        return true;
+    }
+
+    // Uniform functions by handle (see uniform()), no lookup at all
+    void setBool(GLint location, bool value) const
+    {
+        glUniform1i(location, (int)value);
+    }
+
+    void setInt(GLint location, int value) const
+    {
+        glUniform1i(location, value);
+    }
+
+    void setFloat(GLint location, float value) const
+    {
+        glUniform1f(location, value);
+    }
+
+    void setVec2(GLint location, const glm::vec2& value) const
+    {
+        glUniform2fv(location, 1, &value[0]);
+    }
+
+    void setVec3(GLint location, const glm::vec3& value) const
+    {
+        glUniform3fv(location, 1, &value[0]);
+    }
+
+    void setVec4(GLint location, const glm::vec4& value) const
+    {
+        glUniform4fv(location, 1, &value[0]);
+    }
+
+    void setMat2(GLint location, const glm::mat2& mat) const
+    {
+        glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void setMat3(GLint location, const glm::mat3& mat) const
+    {
+        glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    void setMat4(GLint location, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // Uniform functions by name, hashed lookup in the location table (string literals don't allocate)
+    void setBool(const char* name, bool value) const
+    {
+        setBool(uniform(name), value);
     }
 
-    // Uniform functions
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        setBool(uniform(name), value);
+    }
+
+    void setInt(const char* name, int value) const
+    {
+        setInt(uniform(name), value);
     }
 
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(uniform(name), value);
+    }
+
+    void setFloat(const char* name, float value) const
+    {
+        setFloat(uniform(name), value);
     }
 
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        setFloat(uniform(name), value);
+    }
+
+    void setVec2(const char* name, const glm::vec2& value) const
+    {
+        setVec2(uniform(name), value);
     }
 
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec2(uniform(name), value);
+    }
+
+    void setVec2(const char* name, float x, float y) const
+    {
+        glUniform2f(uniform(name), x, y);
     }
 
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(uniform(name), x, y);
+    }
+
+    void setVec3(const char* name, const glm::vec3& value) const
+    {
+        setVec3(uniform(name), value);
     }
 
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec3(uniform(name), value);
+    }
+
+    void setVec3(const char* name, float x, float y, float z) const
+    {
+        glUniform3f(uniform(name), x, y, z);
     }
 
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(uniform(name), x, y, z);
+    }
+
+    void setVec4(const char* name, const glm::vec4& value) const
+    {
+        setVec4(uniform(name), value);
     }
 
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        setVec4(uniform(name), value);
     }
-    void setVec4(const std::string& name, float x, float y, float z, float w)
+
+    void setVec4(const char* name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(uniform(name), x, y, z, w);
+    }
+
+    void setVec4(const std::string& name, float x, float y, float z, float w) const
+    {
+        glUniform4f(uniform(name), x, y, z, w);
+    }
+
+    void setMat2(const char* name, const glm::mat2& mat) const
+    {
+        setMat2(uniform(name), mat);
     }
 
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(uniform(name), mat);
+    }
+
+    void setMat3(const char* name, const glm::mat3& mat) const
+    {
+        setMat3(uniform(name), mat);
     }
 
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(uniform(name), mat);
+    }
+
+    void setMat4(const char* name, const glm::mat4& mat) const
+    {
+        setMat4(uniform(name), mat);
     }
 
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(uniform(name), mat);
     }
 
 private:
+    unsigned int activeAttributeMask = 0;
+
+    // Open addressing table of uniform locations, an empty name marks a free slot
+    struct UniformSlot
+    {
+        uint32_t hash = 0;
+        GLint location = -1;
+        std::string name;
+    };
+    std::vector<UniformSlot> uniformSlots;
+    size_t uniformTotal = 0;
+
+    // Enumerates the active uniforms into the location table, arrays get an entry per element
+    void findActiveUniforms()
+    {
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+
+        std::vector<std::pair<std::string, GLint>> found;
+        for (GLint i = 0; i < count; i++)
+        {
+            GLchar name[256];
+            GLsizei length;
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(ID, static_cast<GLuint>(i), sizeof(name), &length, &size, &type, name);
+            std::string uniformName(name, length);
+
+            // Uniform block members have no location
+            GLint location = glGetUniformLocation(ID, uniformName.c_str());
+            if (location < 0)
+                continue;
+            found.emplace_back(uniformName, location);
+
+            // "values[0]" is reported for arrays, also accept "values" and every element
+            const size_t bracket = uniformName.rfind("[0]");
+            if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+            {
+                const std::string base = uniformName.substr(0, bracket);
+                found.emplace_back(base, location);
+                for (GLint element = 1; element < size; element++)
+                {
+                    const std::string elementName = base + "[" + std::to_string(element) + "]";
+                    GLint elementLocation = glGetUniformLocation(ID, elementName.c_str());
+                    if (elementLocation >= 0)
+                        found.emplace_back(elementName, elementLocation);
+                }
+            }
+        }
+
+        // Keep the table at most half full
+        size_t slots = 8;
+        while (slots < found.size() * 2)
+            slots *= 2;
+        uniformSlots.assign(slots, UniformSlot());
+        uniformTotal = found.size();
+        for (auto& entry : found)
+        {
+            const uint32_t hash = hashUniformName(entry.first.c_str());
+            size_t i = hash & (slots - 1);
+            while (!uniformSlots[i].name.empty())
+                i = (i + 1) & (slots - 1);
+            uniformSlots[i].hash = hash;
+            uniformSlots[i].location = entry.second;
+            uniformSlots[i].name = std::move(entry.first);
+        }
+    }
+
+    // Builds the active attribute location mask
+    void findActiveAttributes()
+    {
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_ATTRIBUTES, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLchar name[256];
+            GLsizei length;
+            GLint size;
+            GLenum type;
+            glGetActiveAttrib(ID, static_cast<GLuint>(i), sizeof(name), &length, &size, &type, name);
+            GLint location = glGetAttribLocation(ID, name);
+            if (location >= 0 && location < 32)
+                activeAttributeMask |= 1u << location;
+        }
+    }
+
     // Checks shader compilation/linking errors
     void checkCompileErrors(GLuint shader, std::string type)
     {
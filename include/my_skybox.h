@@ -6,98 +6,238 @@
 
 #include <stb_image.h>
 
+#include <my_cubemap_cache.h>
+#include <my_gl_state.h>
+#include <my_thread_pool.h>
+#include <my_trace.h>
+
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <string>
 #include <vector>
 
-// Function to load cubemap textures
-GLuint loadCubemap(std::vector<std::string> faces)
+// Per-face timings of a cubemap load
+struct CubemapLoadStats
+{
+    double decodeMs[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    double uploadMs[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    double totalMs = 0.0;
+    unsigned int threads = 1;
+    bool fromContainer = false;
+};
+
+// Decoded cubemap face
+struct CubemapFace
+{
+    unsigned char* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int numChannels = 0;
+    double decodeMs = 0.0;
+};
+
+// Decode one face image (safe to run on a worker thread, no GL calls)
+CubemapFace decodeCubemapFace(const std::string& path)
+{
+    TRACE_SCOPE_DETAIL("load", "Decode cubemap face", path);
+    CubemapFace face;
+    auto start = std::chrono::steady_clock::now();
+    face.data = stbi_load(path.c_str(), &face.width, &face.height, &face.numChannels, 0);
+    face.decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return face;
+}
+
+// Pixel format matching a channel count
+GLenum cubemapFormat(int numChannels)
+{
+    if (numChannels == 1)
+        return GL_RED;
+    if (numChannels == 4)
+        return GL_RGBA;
+    return GL_RGB;
+}
+
+// Sampling parameters of the bound cubemap
+void setCubemapParameters(GLuint mipLevels)
+{
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mipLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, mipLevels - 1);
+}
+
+// Upload a mapped cubemap container straight to GL, no decode step
+GLuint uploadCubemapCache(const CubemapCache& cache, CubemapLoadStats* stats)
+{
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    GLState::instance().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+    // Rows are tightly packed, small mips aren't 4-byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    const GLenum format = cubemapFormat(cache.header.numChannels);
+    for (GLuint face = 0; face < CUBEMAP_FACE_COUNT; face++)
+    {
+        auto uploadStart = std::chrono::steady_clock::now();
+        for (GLuint level = 0; level < cache.header.mipLevels; level++)
+        {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, format,
+                cubemapMipSize(cache.header.width, level), cubemapMipSize(cache.header.height, level), 0,
+                format, GL_UNSIGNED_BYTE, cache.image(level, face));
+        }
+        if (stats)
+            stats->uploadMs[face] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    setCubemapParameters(cache.header.mipLevels);
+    return textureID;
+}
+
+// Function to load cubemap textures. With a pool, the faces are decoded in parallel
+// and this (context) thread only uploads each one once it's ready.
+// With a containerPath, a fresh pre-baked container is uploaded directly instead; if it's
+// missing or stale the PNGs are decoded as usual and baked into it (with a mip chain if
+// bakeMips) for the next start.
+GLuint loadCubemap(std::vector<std::string> faces, ThreadPool* pool = nullptr, CubemapLoadStats* stats = nullptr,
+    const std::string& containerPath = "", bool bakeMips = false)
 {
+    TRACE_SCOPE("load", "loadCubemap");
+    auto start = std::chrono::steady_clock::now();
+
+    // Warm path, pre-baked container
+    if (!containerPath.empty())
+    {
+        CubemapCache cache;
+        if (cache.open(containerPath, faces))
+        {
+            GLuint textureID = uploadCubemapCache(cache, stats);
+            if (stats)
+            {
+                stats->fromContainer = true;
+                stats->threads = 1;
+                stats->totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+            return textureID;
+        }
+    }
+
+    // Kick off all decodes first so the workers run while we wait on the first face
+    std::vector<std::future<CubemapFace>> decoded;
+    if (pool)
+    {
+        for (GLuint i = 0; i < faces.size(); i++)
+        {
+            std::string path = faces[i];
+            decoded.push_back(pool->submit([path]() { return decodeCubemapFace(path); }));
+        }
+    }
+
     GLuint textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    GLState::instance().bindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
+    // Faces are kept around when they're going to be baked into a container
+    const bool bake = !containerPath.empty() && faces.size() == CUBEMAP_FACE_COUNT;
+    std::vector<CubemapFace> bakeFaces;
 
-    int width, height, nrChannels;
     for (GLuint i = 0; i < faces.size(); i++) 
     {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) 
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            
+        CubemapFace face = pool ? decoded[i].get() : decodeCubemapFace(faces[i]);
+
+        auto uploadStart = std::chrono::steady_clock::now();
+        if (face.data) 
+        {
+            GLenum format = cubemapFormat(face.numChannels);
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, face.width, face.height, 0, format, GL_UNSIGNED_BYTE, face.data);
+        }
         else 
             std::cerr << "Failed to load cubemap texture at " << faces[i] << std::endl;
-        stbi_image_free(data);
+
+        if (bake)
+            bakeFaces.push_back(face);
+        else
+            stbi_image_free(face.data);
+
+        if (stats && i < 6)
+        {
+            stats->decodeMs[i] = face.decodeMs;
+            stats->uploadMs[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+        }
     }
 
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    setCubemapParameters(1);
+
+    // Bake the decoded faces for the next start, off this thread when there's a pool
+    if (bake)
+    {
+        auto bakeJob = [faces, bakeFaces, containerPath, bakeMips]()
+        {
+            bool sameLayout = true;
+            std::vector<const unsigned char*> faceData;
+            for (const CubemapFace& face : bakeFaces)
+            {
+                sameLayout = sameLayout && face.data && face.width == bakeFaces[0].width &&
+                    face.height == bakeFaces[0].height && face.numChannels == bakeFaces[0].numChannels;
+                faceData.push_back(face.data);
+            }
+
+            if (!sameLayout || !writeCubemapCache(containerPath, faces, faceData, bakeFaces[0].width, bakeFaces[0].height, bakeFaces[0].numChannels, bakeMips))
+                std::cout << "Could not bake cubemap container " << containerPath << std::endl;
+
+            for (const CubemapFace& face : bakeFaces)
+                stbi_image_free(face.data);
+        };
+
+        if (pool)
+            pool->submit(bakeJob);
+        else
+            bakeJob();
+    }
+
+    if (stats)
+    {
+        stats->threads = pool ? pool->size() : 1;
+        stats->totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
 
     return textureID;
 }
 
-// Skybox cube vertices
-float skyboxVertices[] =
+// Print the per-face timings of a cubemap load
+void printCubemapLoadStats(const std::vector<std::string>& faces, const CubemapLoadStats& stats)
 {
-    // Positions          
-    -1.0f,  1.0f, -1.0f,
-    -1.0f, -1.0f, -1.0f,
-     1.0f, -1.0f, -1.0f,
-     1.0f, -1.0f, -1.0f,
-     1.0f,  1.0f, -1.0f,
-    -1.0f,  1.0f, -1.0f,
-
-    -1.0f, -1.0f,  1.0f,
-    -1.0f, -1.0f, -1.0f,
-    -1.0f,  1.0f, -1.0f,
-    -1.0f,  1.0f, -1.0f,
-    -1.0f,  1.0f,  1.0f,
-    -1.0f, -1.0f,  1.0f,
-
-     1.0f, -1.0f, -1.0f,
-     1.0f, -1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f,
-     1.0f,  1.0f, -1.0f,
-     1.0f, -1.0f, -1.0f,
-
-    -1.0f, -1.0f,  1.0f,
-    -1.0f,  1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f,
-     1.0f, -1.0f,  1.0f,
-    -1.0f, -1.0f,  1.0f,
-
-    -1.0f,  1.0f, -1.0f,
-     1.0f,  1.0f, -1.0f,
-     1.0f,  1.0f,  1.0f,
-     1.0f,  1.0f,  1.0f,
-    -1.0f,  1.0f,  1.0f,
-    -1.0f,  1.0f, -1.0f,
-
-    -1.0f, -1.0f, -1.0f,
-    -1.0f, -1.0f,  1.0f,
-     1.0f, -1.0f, -1.0f,
-     1.0f, -1.0f, -1.0f,
-    -1.0f, -1.0f,  1.0f,
-     1.0f, -1.0f,  1.0f
-};
+    for (GLuint i = 0; i < faces.size() && i < 6; i++)
+        std::cout << "Cubemap face " << faces[i] << ": decode " << stats.decodeMs[i] << " ms, upload " << stats.uploadMs[i] << " ms" << std::endl;
+    std::cout << "Cubemap loaded " << (stats.fromContainer ? "from container" : "from PNG faces") << " in "
+        << stats.totalMs << " ms on " << stats.threads << " threads" << std::endl;
+}
 
-// Function to set up skybox VAO
+// Empty VAO for the skybox, its full-screen triangle is generated from gl_VertexID
+// (the core profile still needs a VAO bound to draw)
 GLuint setupSkyboxVAO()
 {
-    GLuint skyboxVAO, skyboxVBO;
+    GLuint skyboxVAO;
     glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glBindVertexArray(0);
-
     return skyboxVAO;
 }
 
+// Draw the sky behind everything already in the depth buffer, call it after the opaque and
+// refractive geometry with the skybox shader bound. The triangle sits on the far plane, so
+// with GL_LEQUAL covered pixels fail early-z and are never shaded.
+void drawSkybox(GLuint skyboxVAO, GLuint cubemapTexture)
+{
+    GLState& state = GLState::instance();
+    state.depthFunc(GL_LEQUAL);
+    state.depthMask(GL_FALSE);
+    state.bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
+    state.bindVertexArray(skyboxVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    state.depthMask(GL_TRUE);
+    state.depthFunc(GL_LESS);
+}
+
 #endif // MY_SKYBOX_H
@@ -0,0 +1,157 @@
+#ifndef MY_TEXTURE_REGISTRY_H
+#define MY_TEXTURE_REGISTRY_H
+
+#include <glad/glad.h>
+
+#include <stb_image.h>
+
+#include <my_gl_state.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+
+// Loads a 2D texture (with mipmaps), returns its GL id. bytesResident receives
+// the GPU memory taken by the whole mip chain.
+unsigned int loadTexture(const char* texturePath, size_t* bytesResident = nullptr)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    stbi_set_flip_vertically_on_load(false);
+    int width, height, numChannels;
+    unsigned char* data = stbi_load(texturePath, &width, &height, &numChannels, 0);
+    if (data)
+    {
+        GLenum format = GL_RGB;
+        if (numChannels == 1)
+            format = GL_RED;
+        else if (numChannels == 3)
+            format = GL_RGB;
+        else if (numChannels == 4)
+            format = GL_RGBA;
+
+        GLState::instance().bindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        if (bytesResident)
+        {
+            *bytesResident = 0;
+            for (int w = width, h = height; ; w = w > 1 ? w / 2 : 1, h = h > 1 ? h / 2 : 1)
+            {
+                *bytesResident += static_cast<size_t>(w) * h * numChannels;
+                if (w == 1 && h == 1)
+                    break;
+            }
+        }
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << texturePath << std::endl;
+        if (bytesResident)
+            *bytesResident = 0;
+    }
+
+    stbi_image_free(data);
+
+    return textureID;
+}
+
+// GL texture shared between every mesh that references the same file
+struct SharedTexture
+{
+    unsigned int id = 0;
+    std::string path;
+    size_t bytes = 0;
+};
+
+// Process-wide registry of 2D textures keyed by canonical path. Handles are
+// shared, the GL texture is deleted when the last one goes away.
+// Only use from the thread owning the GL context.
+class TextureRegistry
+{
+public:
+    static TextureRegistry& instance()
+    {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    // Shared handle for the texture at path, loading it on first use
+    std::shared_ptr<SharedTexture> acquire(const std::string& path)
+    {
+        const std::string key = canonicalPath(path);
+        auto found = textures.find(key);
+        if (found != textures.end())
+        {
+            std::shared_ptr<SharedTexture> texture = found->second.lock();
+            if (texture)
+            {
+                hitCount++;
+                return texture;
+            }
+        }
+
+        missCount++;
+        SharedTexture* texture = new SharedTexture();
+        texture->path = key;
+        texture->id = loadTexture(path.c_str(), &texture->bytes);
+        residentBytes += texture->bytes;
+
+        std::shared_ptr<SharedTexture> handle(texture, [this](SharedTexture* released) { release(released); });
+        textures[key] = handle;
+        return handle;
+    }
+
+    // The GL context is about to go away, handles released later won't touch GL
+    void detachContext()
+    {
+        contextAttached = false;
+    }
+
+    uint64_t hits() const { return hitCount; }
+    uint64_t misses() const { return missCount; }
+    size_t bytesResident() const { return residentBytes; }
+    size_t texturesResident() const { return textures.size(); }
+
+private:
+    std::unordered_map<std::string, std::weak_ptr<SharedTexture>> textures;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+    size_t residentBytes = 0;
+    bool contextAttached = true;
+
+    TextureRegistry() {}
+
+    static std::string canonicalPath(const std::string& path)
+    {
+        std::error_code ec;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(path, ec);
+        return ec ? path : canonical.generic_string();
+    }
+
+    // Last handle dropped
+    void release(SharedTexture* texture)
+    {
+        auto found = textures.find(texture->path);
+        if (found != textures.end() && found->second.expired())
+            textures.erase(found);
+
+        residentBytes -= texture->bytes;
+        if (contextAttached)
+            GLState::instance().deleteTexture(texture->id);
+        delete texture;
+    }
+};
+#endif // MY_TEXTURE_REGISTRY_H
@@ -0,0 +1,98 @@
+#ifndef MY_THREAD_POOL_H
+#define MY_THREAD_POOL_H
+
+#include <my_trace.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads for CPU-side loading work (never GL calls)
+class ThreadPool
+{
+public:
+    // Defaults to one worker per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0)
+    {
+        if (threadCount == 0)
+            threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0)
+            threadCount = 1;
+
+        for (unsigned int i = 0; i < threadCount; i++)
+        {
+            workers.emplace_back([this, i]()
+            {
+                Trace::instance().setThreadName("Worker " + std::to_string(i));
+                workerLoop();
+            });
+        }
+    }
+
+    // Finishes queued jobs, then joins the workers
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a job, the future carries its result (or exception)
+    template<typename F>
+    auto submit(F&& job) -> std::future<decltype(job())>
+    {
+        typedef decltype(job()) Result;
+        std::shared_ptr<std::packaged_task<Result()>> task =
+            std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            jobs.push_back([task]() { (*task)(); });
+        }
+        queueCondition.notify_one();
+        return result;
+    }
+
+    unsigned int size() const
+    {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueCondition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+#endif // MY_THREAD_POOL_H
@@ -0,0 +1,240 @@
+#ifndef MY_TRACE_H
+#define MY_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timeline instrumentation, exported as Chrome trace-event JSON (chrome://tracing or
+// ui.perfetto.dev). TRACE_SCOPE(category, name) records the enclosing scope as one complete
+// event in the calling thread's ring buffer, which keeps the last TRACE_BUFFER_EVENTS events.
+// Recording never locks: each ring has a single writer, its own thread, and only a thread's
+// first event takes the registry lock. With tracing switched off a scope costs a load and a
+// branch; define MY_TRACE_DISABLED to compile the scopes out entirely.
+// Categories and names must be string literals (only the pointer is kept), details are copied.
+// Only detail strings need escaping in the export, names are assumed plain.
+
+// Events kept per thread (a power of two) and detail characters kept per event
+const size_t TRACE_BUFFER_EVENTS = 16384;
+const size_t TRACE_DETAIL_LENGTH = 48;
+
+// Copy detail into an event's buffer, longer details keep their end (where a path's file name is)
+void copyTraceDetail(char* target, const char* detail)
+{
+    const size_t length = std::strlen(detail);
+    const size_t kept = std::min(length, TRACE_DETAIL_LENGTH - 1);
+    std::memcpy(target, detail + (length - kept), kept);
+    target[kept] = '\0';
+}
+
+struct TraceEvent
+{
+    const char* category = "";
+    const char* name = "";
+    uint64_t startNs = 0;
+    uint64_t durationNs = 0;
+    char detail[TRACE_DETAIL_LENGTH] = {};
+};
+
+class Trace
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static Trace& instance()
+    {
+        static Trace trace;
+        return trace;
+    }
+
+    void setEnabled(bool enable) { recording.store(enable, std::memory_order_relaxed); }
+    bool enabled() const { return recording.load(std::memory_order_relaxed); }
+
+    // Nanoseconds since the process started tracing
+    uint64_t now() const
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count());
+    }
+
+    // Name the calling thread in the exported trace, threads get a ring only once they record
+    void setThreadName(const std::string& name)
+    {
+        ThreadState& state = threadState();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        state.name = name;
+        if (state.ring)
+            state.ring->name = name;
+    }
+
+    // Append a finished event to the calling thread's ring, overwriting the oldest when full
+    void record(const char* category, const char* name, uint64_t startNs, uint64_t endNs, const char* detail)
+    {
+        ThreadBuffer& ring = threadBuffer();
+        const uint64_t index = ring.head.load(std::memory_order_relaxed);
+        TraceEvent& event = ring.events[index & (TRACE_BUFFER_EVENTS - 1)];
+        event.category = category;
+        event.name = name;
+        event.startNs = startNs;
+        event.durationNs = endNs - startNs;
+        copyTraceDetail(event.detail, detail);
+        ring.head.store(index + 1, std::memory_order_release);
+    }
+
+    // Write every buffered event as trace-event JSON, the rings keep their contents. Other
+    // threads may go on recording: events they overwrite while their ring is copied are left out
+    bool write(const std::string& path)
+    {
+        FILE* file = std::fopen(path.c_str(), "w");
+        if (!file)
+        {
+            std::cout << "ERROR::TRACE:: Could not write " << path << std::endl;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        std::vector<TraceEvent> events;
+        for (const std::unique_ptr<ThreadBuffer>& ring : buffers)
+        {
+            std::fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":%s}}",
+                first ? "" : ",\n", ring->id, quoted(ring->name).c_str());
+            first = false;
+
+            const uint64_t head = ring->head.load(std::memory_order_acquire);
+            const uint64_t begin = head > TRACE_BUFFER_EVENTS ? head - TRACE_BUFFER_EVENTS : 0;
+            events.clear();
+            for (uint64_t i = begin; i < head; i++)
+                events.push_back(ring->events[i & (TRACE_BUFFER_EVENTS - 1)]);
+
+            // Slots the writer reached again during the copy hold newer events than we think
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t after = ring->head.load(std::memory_order_relaxed);
+            const uint64_t valid = after > TRACE_BUFFER_EVENTS ? after - TRACE_BUFFER_EVENTS : 0;
+            for (uint64_t i = std::max(begin, valid); i < head; i++)
+            {
+                const TraceEvent& event = events[i - begin];
+                std::fprintf(file, ",\n{\"ph\":\"X\",\"cat\":\"%s\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                    event.category, event.name, ring->id, event.startNs / 1000.0, event.durationNs / 1000.0);
+                if (event.detail[0])
+                    std::fprintf(file, ",\"args\":{\"detail\":%s}", quoted(event.detail).c_str());
+                std::fprintf(file, "}");
+            }
+        }
+        std::fprintf(file, "\n]}\n");
+        return std::fclose(file) == 0;
+    }
+
+private:
+    struct ThreadBuffer
+    {
+        std::atomic<uint64_t> head{ 0 };
+        unsigned int id = 0;
+        std::string name;
+        TraceEvent events[TRACE_BUFFER_EVENTS];
+    };
+
+    struct ThreadState
+    {
+        ThreadBuffer* ring = nullptr;
+        std::string name;
+    };
+
+    std::atomic<bool> recording{ false };
+    const Clock::time_point epoch = Clock::now();
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;     // Outlive their threads, for the export
+
+    static ThreadState& threadState()
+    {
+        thread_local ThreadState state;
+        return state;
+    }
+
+    ThreadBuffer& threadBuffer()
+    {
+        ThreadState& state = threadState();
+        if (!state.ring)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffers.emplace_back(new ThreadBuffer());
+            state.ring = buffers.back().get();
+            state.ring->id = static_cast<unsigned int>(buffers.size());
+            state.ring->name = state.name.empty() ? "Thread " + std::to_string(state.ring->id) : state.name;
+        }
+        return *state.ring;
+    }
+
+    // JSON string literal of text
+    static std::string quoted(const std::string& text)
+    {
+        std::string result = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            result += c;
+        }
+        return result + "\"";
+    }
+};
+
+// Records its lifetime as an event when tracing was on at construction
+class TraceScope
+{
+public:
+    TraceScope(const char* category, const char* name, const char* detail = "")
+        : category(category), name(name)
+    {
+        Trace& trace = Trace::instance();
+        if (!trace.enabled())
+            return;
+        active = true;
+        copyTraceDetail(this->detail, detail);
+        startNs = trace.now();
+    }
+
+    TraceScope(const char* category, const char* name, const std::string& detail)
+        : TraceScope(category, name, detail.c_str())
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (active)
+        {
+            Trace& trace = Trace::instance();
+            trace.record(category, name, startNs, trace.now(), detail);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* category;
+    const char* name;
+    bool active = false;
+    uint64_t startNs = 0;
+    char detail[TRACE_DETAIL_LENGTH] = {};
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifndef MY_TRACE_DISABLED
+#define TRACE_SCOPE(category, name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(category, name)
+#define TRACE_SCOPE_DETAIL(category, name, detail) TraceScope TRACE_CONCAT(traceScope, __LINE__)(category, name, detail)
+#else
+#define TRACE_SCOPE(category, name) ((void)0)
+#define TRACE_SCOPE_DETAIL(category, name, detail) ((void)0)
+#endif
+#endif // MY_TRACE_H
@@ -0,0 +1,116 @@
+#ifndef MY_UNIFORM_BUFFERS_H
+#define MY_UNIFORM_BUFFERS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <my_gl_state.h>
+#include <my_shader.h>
+
+#include <cstdint>
+#include <cstring>
+
+// Per-frame uniform blocks shared by every program. Each block lives in one uniform buffer
+// bound to a fixed binding point, programs only map their block index to that point.
+
+const GLuint CAMERA_BLOCK_BINDING = 0;
+const GLuint MATERIAL_BLOCK_BINDING = 1;
+
+// layout(std140) uniform CameraBlock, mat4 columns are vec4 aligned so no padding is needed.
+// Everything derived from the camera is computed once on the CPU, not per vertex
+struct CameraBlock
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 inverseProjection;
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPosition;   // World space, w = 1
+};
+static_assert(sizeof(CameraBlock) == 4 * 64 + 16, "CameraBlock must match the std140 layout");
+
+// Camera block for a view and projection, for callers without a cached Camera
+CameraBlock makeCameraBlock(const glm::mat4& view, const glm::mat4& projection)
+{
+    return { view, projection, glm::inverse(projection), projection * view, glm::inverse(view)[3] };
+}
+
+// Matrix taking object space normals to world space (inverse transpose of the upper 3x3),
+// computed once per object instead of per vertex
+glm::mat3 normalMatrix(const glm::mat4& model)
+{
+    return glm::transpose(glm::inverse(glm::mat3(model)));
+}
+
+// layout(std140) uniform MaterialBlock, scalars pack into consecutive 4-byte slots
+struct MaterialBlock
+{
+    float etaR;
+    float etaG;
+    float etaB;
+    float F0;
+};
+static_assert(sizeof(MaterialBlock) == 16, "MaterialBlock must match the std140 layout");
+
+// GL uniform buffer holding one Block, re-uploaded only when its contents change
+template <typename Block>
+class UniformBuffer
+{
+public:
+    explicit UniformBuffer(GLuint binding)
+        : binding(binding)
+    {
+        glGenBuffers(1, &buffer);
+        GLState::instance().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        GLState::instance().bindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+    }
+
+    ~UniformBuffer()
+    {
+        destroy();
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    // Upload block if it differs from what the buffer holds, returns whether it did
+    bool update(const Block& block)
+    {
+        if (uploaded && std::memcmp(&current, &block, sizeof(Block)) == 0)
+            return false;
+
+        GLState::instance().bindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+        current = block;
+        uploaded = true;
+        uploadCount++;
+        return true;
+    }
+
+    // Delete the buffer while the GL context is still current
+    void destroy()
+    {
+        if (buffer)
+            GLState::instance().deleteBuffer(buffer);
+        buffer = 0;
+    }
+
+    GLuint bindingPoint() const { return binding; }
+    uint64_t uploads() const { return uploadCount; }
+
+private:
+    GLuint buffer = 0;
+    GLuint binding;
+    Block current;
+    bool uploaded = false;
+    uint64_t uploadCount = 0;
+};
+
+// Map the shared blocks a program declares to their binding points (GLSL 330 has no binding layout)
+void bindFrameUniformBlocks(const Shader& shader)
+{
+    shader.bindUniformBlock("CameraBlock", CAMERA_BLOCK_BINDING);
+    shader.bindUniformBlock("MaterialBlock", MATERIAL_BLOCK_BINDING);
+}
+#endif // MY_UNIFORM_BUFFERS_H
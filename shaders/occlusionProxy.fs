@@ -0,0 +1,9 @@
+#version 330 core
+
+// Colour writes are masked off, only the depth test of the proxy matters
+out vec4 FragColor;
+
+void main() 
+{
+    FragColor = vec4(1.0);
+}
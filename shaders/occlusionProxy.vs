@@ -0,0 +1,21 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;  // Unit cube corner
+
+// Unit cube to world, the object's bounding box (my_occlusion.h)
+uniform mat4 box;
+
+// Shared per-frame camera (my_uniform_buffers.h)
+layout(std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 inverseProjection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+void main() 
+{
+    gl_Position = viewProjection * box * vec4(aPos, 1.0);
+}
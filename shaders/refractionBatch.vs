@@ -0,0 +1,37 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;          // Vertex position
+layout(location = 1) in vec3 aNormal;       // Vertex normal
+layout(location = 3) in uint aDrawIndex;    // Object of this draw (my_scene_batch.h)
+
+// Object transforms, seven texels per object: model matrix columns then normal matrix columns
+uniform samplerBuffer transforms;
+
+// Shared per-frame camera (my_uniform_buffers.h)
+layout(std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 inverseProjection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
+
+out vec3 V; // View direction
+out vec3 N; // Normal vector
+
+void main() 
+{
+    int base = int(aDrawIndex) * 7;
+    mat4 model = mat4(texelFetch(transforms, base), texelFetch(transforms, base + 1),
+        texelFetch(transforms, base + 2), texelFetch(transforms, base + 3));
+    mat3 normalMatrix = mat3(texelFetch(transforms, base + 4).xyz, texelFetch(transforms, base + 5).xyz,
+        texelFetch(transforms, base + 6).xyz);
+
+    vec4 worldPos = model * vec4(aPos, 1.0);
+    V = normalize(cameraPosition.xyz - worldPos.xyz); // Compute view direction
+
+    N = normalize(normalMatrix * aNormal); // Correct normal transformation
+    
+    gl_Position = viewProjection * worldPos;
+}
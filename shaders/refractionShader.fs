@@ -7,11 +7,15 @@ out vec4 FragColor;
 
 uniform samplerCube skybox; // Environment map
 
-// Dispersion values for RGB
-uniform float etaR;   
-uniform float etaG; 
-uniform float etaB;  
-uniform float F0; // Base reflectance for dielectrics
+// Shared material parameters (my_uniform_buffers.h)
+layout(std140) uniform MaterialBlock
+{
+    // Dispersion values for RGB
+    float etaR;
+    float etaG;
+    float etaB;
+    float F0; // Base reflectance for dielectrics
+};
 
 // Fresnel-Schlick approximation
 float fresnelSchlick(float cosTheta) 
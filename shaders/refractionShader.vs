@@ -4,9 +4,17 @@ layout(location = 0) in vec3 aPos;     // Vertex position
 layout(location = 1) in vec3 aNormal;  // Vertex normal
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 inverseProjection;
+uniform mat3 normalMatrix;  // Inverse transpose of the model's 3x3, computed on the CPU
+
+// Shared per-frame camera (my_uniform_buffers.h)
+layout(std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 inverseProjection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
 
 out vec3 V; // View direction
 out vec3 N; // Normal vector
@@ -14,11 +22,9 @@ out vec3 N; // Normal vector
 void main() 
 {
     vec4 worldPos = model * vec4(aPos, 1.0);
-    vec3 viewPos = vec3(inverse(view) * vec4(0.0, 0.0, 0.0, 1.0)); // Camera position
-    V = normalize(viewPos - worldPos.xyz); // Compute view direction
+    V = normalize(cameraPosition.xyz - worldPos.xyz); // Compute view direction
 
-    vec3 I = -V; // Incident light direction
-    N = normalize(mat3(transpose(inverse(model))) * aNormal); // Correct normal transformation
+    N = normalize(normalMatrix * aNormal); // Correct normal transformation
     
-    gl_Position = projection * view * worldPos;
+    gl_Position = viewProjection * worldPos;
 }
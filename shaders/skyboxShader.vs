@@ -1,14 +1,26 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
-
 out vec3 TexCoords;
 
-uniform mat4 view;
-uniform mat4 projection;
+// Shared per-frame camera (my_uniform_buffers.h)
+layout(std140) uniform CameraBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 inverseProjection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+};
 
 void main() 
 {
-    TexCoords = aPos;  
-    gl_Position = projection * view * vec4(aPos, 1.0);
+    // Full-screen triangle from the vertex id: (-1,-1), (3,-1), (-1,3)
+    vec2 position = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
+
+    // Inverse view-projection without the view translation gives the world direction
+    vec4 viewDirection = inverseProjection * vec4(position, 1.0, 1.0);
+    TexCoords = transpose(mat3(view)) * (viewDirection.xyz / viewDirection.w);
+
+    // z = w puts the triangle exactly on the far plane
+    gl_Position = vec4(position, 1.0, 1.0);
 }
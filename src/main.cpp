@@ -6,12 +6,32 @@
 #include <GLFW/glfw3.h>
 
 #include <my_shader.h>
+#include <my_benchmark.h>
 #include <my_camera.h>
+#include <my_frame_pacer.h>
+#include <my_frustum.h>
+#include <my_gl_state.h>
+#include <my_gpu_query.h>
+#include <my_headless.h>
 #include <my_model.h>
+#include <my_model_loader.h>
+#include <my_occlusion.h>
+#include <my_profiler.h>
+#include <my_render_queue.h>
+#include <my_scene_batch.h>
 #include <my_skybox.h>
+#include <my_thread_pool.h>
+#include <my_trace.h>
+#include <my_uniform_buffers.h>
 
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <random>
+#include <sstream>
+#include <string>
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -44,6 +64,7 @@ float prevFrame = 0.0f;
 #define DONUT_MODEL "models/donut.obj"
 #define SPHERE_MODEL "models/sphere.obj"
 #define MONKEY_MODEL "models/suzanne_monkey.obj"
+#define SKYBOX_CONTAINER "cache/skybox.cubemap"
 
 // Camera specs (set later, can't call functions here)
 const float cameraSpeed = 3.0f;
@@ -80,6 +101,42 @@ const char* dispersionOptions[] = { "None", "Weak", "Strong" };
 int selectedDispersion = None;
 float dispersionAmount = 0.0f;
 
+// Level of detail
+bool lodEnabled = true;
+float lodPixelError = 1.0f;
+size_t trianglesDrawn = 0;
+
+// Scene batching (one multi-draw for every object)
+const int SCENE_OBJECT_COUNT = 4;
+bool batchedDraws = false;
+bool batchIndirect = false;
+
+// Render queue counters of the last frame
+RenderQueueStats queueStats;
+
+// View-frustum culling, meshes outside the camera's view are not submitted
+bool frustumCulling = true;
+CullStats cullStats;
+
+// Occlusion culling of the unbatched path, objects whose box was hidden last frame are skipped
+bool occlusionCulling = false;
+OcclusionStats occlusionStats;
+
+// Frame pacing, the pacer applies changes to these at the next present
+int presentMode = static_cast<int>(PresentMode::VSync);
+float frameCapFps = 120.0f;
+bool resetFrameStats = false;
+FrameTimeStats frameTimeStats;
+
+// GPU and CPU time of each render pass, shown a few frames late (see my_profiler.h)
+GpuProfiler passProfiler;
+
+// Timeline trace (see my_trace.h), T writes it here, so does exit when --trace was given
+std::string tracePath = "trace.json";
+
+// Fragments the skybox shaded (a few frames late, see SamplesPassedCounter)
+uint64_t skyboxFragments = 0;
+
 void updateMaterialProperties(int materialIndex) 
 {
     switch (materialIndex) 
@@ -173,13 +230,104 @@ void drawIMGUIWindow()
         std::string etaBlueStr = "Eta Blue: " + std::to_string(etaB);
         ImGui::Text(etaBlueStr.c_str());
     }
+
+    // LOD controls
+    ImGui::Checkbox("LODs", &lodEnabled);
+    ImGui::SliderFloat("LOD Pixel Error", &lodPixelError, 0.25f, 8.0f);
+    ImGui::Text("Triangles: %zu", trianglesDrawn);
+    ImGui::Checkbox("Frustum culling", &frustumCulling);
+    ImGui::Text("Meshes: %zu visible, %zu culled of %zu", cullStats.visible, cullStats.culled, cullStats.tested);
+    ImGui::Checkbox("Occlusion culling (unbatched draws)", &occlusionCulling);
+    ImGui::Text("Objects occluded last frame: %zu of %zu", occlusionStats.occluded, occlusionStats.tested);
+    ImGui::Text("Skybox fragments: %llu (%.1f%% of the screen)", static_cast<unsigned long long>(skyboxFragments),
+        100.0 * static_cast<double>(skyboxFragments) / (static_cast<double>(SCREEN_WIDTH) * SCREEN_HEIGHT));
+    ImGui::Text("Queue: %zu commands, %zu program / %zu VAO / %zu texture changes", queueStats.commands,
+        queueStats.programChanges, queueStats.vertexArrayChanges, queueStats.textureChanges);
+    const GLStateStats& stateCalls = GLState::instance().lastFrame();
+    ImGui::Text("GL state calls: %llu issued, %llu elided", static_cast<unsigned long long>(stateCalls.issued),
+        static_cast<unsigned long long>(stateCalls.elided));
+    ImGui::Combo("Present mode", &presentMode, PRESENT_MODE_NAMES, IM_ARRAYSIZE(PRESENT_MODE_NAMES));
+    if (presentMode == static_cast<int>(PresentMode::FrameCap))
+        ImGui::SliderFloat("Frame cap (FPS)", &frameCapFps, 15.0f, 360.0f);
+    ImGui::Text("Frame time: %.2f ms mean, %.3f ms std dev, %.2f / %.2f ms min / max", frameTimeStats.meanMs,
+        frameTimeStats.standardDeviation(), frameTimeStats.frames ? frameTimeStats.minMs : 0.0, frameTimeStats.maxMs);
+    resetFrameStats = ImGui::Button("Reset frame times");
+    ImGui::Checkbox("Pass profiler", &passProfiler.enabled);
+    bool tracing = Trace::instance().enabled();
+    if (ImGui::Checkbox("Record trace", &tracing))
+        Trace::instance().setEnabled(tracing);
+    ImGui::SameLine();
+    ImGui::Text("(T writes %s)", tracePath.c_str());
+    for (const PassTiming& pass : passProfiler.passes())
+        ImGui::Text("%*s%-18s GPU %6.3f ms   CPU %6.3f ms", pass.depth * 2, "", pass.name.c_str(),
+            pass.averageGpuMs(), pass.averageCpuMs());
+    ImGui::Checkbox(batchIndirect ? "Batched draws (multi-draw indirect)" : "Batched draws (base vertex fallback)", &batchedDraws);
     ImGui::End();
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
-// Main function
-int main()
+// Write the trace buffers out, recording carries on
+void writeTrace()
+{
+    if (Trace::instance().write(tracePath))
+        std::cout << "Trace written to " << tracePath << std::endl;
+}
+
+// Command line options
+struct RunOptions
+{
+    bool headless = false;      // Surfaceless EGL context and an offscreen framebuffer, no ImGui or input
+    int width = 1280;           // Headless resolution, the window always covers the primary monitor
+    int height = 720;
+    int frames = 300;           // Headless or benchmark frames to render before exiting
+    std::string output;         // Headless: save the last frame here (PPM)
+    std::string benchmark;      // Keyframe script driving camera and material (my_benchmark.h)
+    std::string report;         // Benchmark: JSON report path
+    std::string trace;          // Record a trace from startup and write it here at exit
+};
+
+// Parse argv into options, false (after printing the usage) on anything unknown
+bool parseRunOptions(int argc, char** argv, RunOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--headless") == 0)
+            options.headless = true;
+        else if (std::strcmp(argv[i], "--width") == 0 && hasValue)
+            options.width = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--height") == 0 && hasValue)
+            options.height = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--frames") == 0 && hasValue)
+            options.frames = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--output") == 0 && hasValue)
+            options.output = argv[++i];
+        else if (std::strcmp(argv[i], "--benchmark") == 0 && hasValue)
+            options.benchmark = argv[++i];
+        else if (std::strcmp(argv[i], "--report") == 0 && hasValue)
+            options.report = argv[++i];
+        else if (std::strcmp(argv[i], "--trace") == 0 && hasValue)
+            options.trace = argv[++i];
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--headless [--width W] [--height H] [--output frame.ppm]]"
+                << " [--benchmark script.txt [--report report.json]] [--frames N] [--trace trace.json]" << std::endl;
+            return false;
+        }
+    }
+    if (options.width <= 0 || options.height <= 0 || options.frames <= 0)
+    {
+        std::cout << "ERROR::OPTIONS:: Width, height and frames must be positive" << std::endl;
+        return false;
+    }
+    if (!options.benchmark.empty() && options.report.empty())
+        options.report = "benchmark.json";
+    return true;
+}
+
+// Fullscreen window on the primary monitor with a current GL context, nullptr on failure
+GLFWwindow* createMainWindow()
 {
     // glfw init and configure
     glfwInit();
@@ -199,7 +347,7 @@ int main()
     {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
-        return -1;
+        return nullptr;
     }
     glfwMakeContextCurrent(window);
 
@@ -218,22 +366,142 @@ int main()
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
         std::cout << "Failed to initialize GLAD" << std::endl;
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return nullptr;
+    }
+    return window;
+}
+
+// Main function
+int main(int argc, char** argv)
+{
+    RunOptions options;
+    if (!parseRunOptions(argc, argv, options))
+        return -1;
+
+    // Tracing from the start catches shader compiles and asset loads
+    Trace::instance().setThreadName("Main");
+    if (!options.trace.empty())
+    {
+        tracePath = options.trace;
+        Trace::instance().setEnabled(true);
+    }
+
+    // Scripted benchmark: the keyframes replace user input, the run ends after options.frames
+    BenchmarkScript benchmarkScript;
+    const bool benchmarking = !options.benchmark.empty();
+    if (benchmarking && !benchmarkScript.load(options.benchmark))
         return -1;
+
+    // Either a window on the primary monitor or, headless, a surfaceless context drawing into
+    // an offscreen framebuffer at the requested resolution
+    GLFWwindow* window = nullptr;
+    HeadlessContext headlessContext;
+    OffscreenTarget offscreenTarget;
+    if (options.headless)
+    {
+        if (!headlessContext.create() || !offscreenTarget.create(options.width, options.height))
+            return -1;
+        SCREEN_WIDTH = options.width;
+        SCREEN_HEIGHT = options.height;
+    }
+    else
+    {
+        window = createMainWindow();
+        if (!window)
+            return -1;
     }
 
     // Configure global OpenGL state
-    glEnable(GL_DEPTH_TEST);    // Depth-testing
-    glDepthFunc(GL_LESS);       // Smaller value as "closer" for depth-testing
+    // Configured through the state cache (my_gl_state.h) like every other bind and toggle
+    GLState& glState = GLState::instance();
+    glState.enable(GL_DEPTH_TEST);      // Depth-testing
+    glState.depthFunc(GL_LESS);         // Smaller value as "closer" for depth-testing
+
+    // Input and ImGui only when someone is watching and steering
+    const bool interactive = window && !benchmarking;
+
+    // Swap interval and frame limiter (the headless loop has nothing to present), benchmarks
+    // run as fast as they can
+    if (benchmarking)
+        presentMode = static_cast<int>(PresentMode::Uncapped);
+    std::unique_ptr<FramePacer> framePacer;
+    if (window)
+        framePacer.reset(new FramePacer(window, static_cast<PresentMode>(presentMode), frameCapFps));
 
     // Build and compile shaders
     Shader skyboxShader("shaders/skyboxShader.vs", "shaders/skyboxShader.fs");
     Shader refractionShader("shaders/refractionShader.vs", "shaders/refractionShader.fs");
-
-    // Load models
-    Model teapotModel(TEAPOT_MODEL);
-    Model donutModel(DONUT_MODEL);
-    Model sphereModel(SPHERE_MODEL);
-    Model monkeyModel(MONKEY_MODEL);
+    Shader refractionBatchShader("shaders/refractionBatch.vs", "shaders/refractionShader.fs");
+    Shader occlusionProxyShader("shaders/occlusionProxy.vs", "shaders/occlusionProxy.fs");
+
+    // Camera and material parameters are shared by both programs through uniform buffers
+    UniformBuffer<CameraBlock> cameraBuffer(CAMERA_BLOCK_BINDING);
+    UniformBuffer<MaterialBlock> materialBuffer(MATERIAL_BLOCK_BINDING);
+    bindFrameUniformBlocks(skyboxShader);
+    bindFrameUniformBlocks(refractionShader);
+    bindFrameUniformBlocks(refractionBatchShader);
+    bindFrameUniformBlocks(occlusionProxyShader);
+
+    // Both programs sample the skybox from unit 0
+    skyboxShader.use();
+    skyboxShader.setInt("skybox", 0);
+    refractionShader.use();
+    refractionShader.setInt("skybox", 0);
+    refractionBatchShader.use();
+    refractionBatchShader.setInt("skybox", 0);
+
+    // Uniform handles used every frame, resolved once
+    const GLint modelUniform = refractionShader.uniform("model");
+    const GLint normalMatrixUniform = refractionShader.uniform("normalMatrix");
+
+    // Per-frame draw queue for the unbatched path
+    RenderQueue renderQueue;
+    FrustumCuller frustumCuller;
+    OcclusionCuller occlusionCuller(occlusionProxyShader);
+
+    // Load models, parsing runs on the worker pool while this thread uploads finished ones
+    auto loadStart = std::chrono::steady_clock::now();
+    ThreadPool workerPool;
+    // CPU geometry is kept until it has been copied into the scene batch
+    Model teapotModel(GeometryRetention::Keep), donutModel(GeometryRetention::Keep),
+        sphereModel(GeometryRetention::Keep), monkeyModel(GeometryRetention::Keep);
+
+    // Only upload the attributes the refraction shader reads, in packed form
+    teapotModel.setVertexFormatFor(refractionShader);
+    donutModel.setVertexFormatFor(refractionShader);
+    sphereModel.setVertexFormatFor(refractionShader);
+    monkeyModel.setVertexFormatFor(refractionShader);
+    ModelLoader modelLoader(workerPool);
+    modelLoader.load(teapotModel, TEAPOT_MODEL);
+    modelLoader.load(donutModel, DONUT_MODEL);
+    modelLoader.load(sphereModel, SPHERE_MODEL);
+    modelLoader.load(monkeyModel, MONKEY_MODEL);
+    modelLoader.finish();
+    std::cout << "Models loaded in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count()
+        << " ms on " << workerPool.size() << " worker threads" << std::endl;
+    std::cout << "Vertex buffers: " << (teapotModel.vertexBufferBytes() + donutModel.vertexBufferBytes() +
+        sphereModel.vertexBufferBytes() + monkeyModel.vertexBufferBytes()) / 1024 << " KiB ("
+        << teapotModel.vertexFormat.stride() << " bytes per vertex, " << sizeof(Vertex) << " unpacked), index buffers: "
+        << (teapotModel.indexBufferBytes() + donutModel.indexBufferBytes() + sphereModel.indexBufferBytes() + monkeyModel.indexBufferBytes()) / 1024
+        << " KiB" << std::endl;
+
+    // Same models packed into shared buffers for the batched path, then nothing reads the CPU copies
+    Model* sceneModels[SCENE_OBJECT_COUNT] = { &teapotModel, &sphereModel, &donutModel, &monkeyModel };
+    SceneBatch sceneBatch(selectVertexFormat(refractionBatchShader.activeAttributes()));
+    unsigned int sceneObjects[SCENE_OBJECT_COUNT];
+    for (int i = 0; i < SCENE_OBJECT_COUNT; i++)
+        sceneObjects[i] = sceneBatch.addObject(sceneBatch.addModel(*sceneModels[i]));
+    sceneBatch.upload();
+    sceneBatch.bindShader(refractionBatchShader);
+    batchIndirect = sceneBatch.usesIndirectDraws();
+    for (int i = 0; i < SCENE_OBJECT_COUNT; i++)
+        sceneModels[i]->releaseGeometry();
+
+    TextureRegistry& textureRegistry = TextureRegistry::instance();
+    std::cout << "Textures: " << textureRegistry.texturesResident() << " resident (" << textureRegistry.bytesResident() / 1024 << " KiB), "
+        << textureRegistry.hits() << " hits, " << textureRegistry.misses() << " misses" << std::endl;
 
     // Fine tune camera params
     camera.setMouseSensitivity(mouseSensitivity);
@@ -241,27 +509,32 @@ int main()
     camera.setZoom(cameraZoom);
     camera.setFPSCamera(false, yPosInit);
     camera.setZoomEnabled(false);
+    camera.setProjection(static_cast<float>(SCREEN_WIDTH) / static_cast<float>(SCREEN_HEIGHT), 0.1f, 1000.0f);
 
-    // IMGUI setup
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO& io = ImGui::GetIO(); (void)io;
-    ImGui::StyleColorsDark();
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 330");
-
-    // Set font
-    io.Fonts->Clear();
-    ImFont* myFont = io.Fonts->AddFontFromFileTTF(
-        "C:\\fonts\\Open_Sans\\static\\OpenSans_Condensed-Regular.ttf", 30.0f); // Adjust size here
-
-    // Rebuild the font atlas
-    unsigned char* pixels;
-    int width, height;
-    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    // IMGUI setup (interactive only)
+    if (interactive)
+    {
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO(); (void)io;
+        ImGui::StyleColorsDark();
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+        ImGui_ImplOpenGL3_Init("#version 330");
+
+        // Set font
+        io.Fonts->Clear();
+        ImFont* myFont = io.Fonts->AddFontFromFileTTF(
+            "C:\\fonts\\Open_Sans\\static\\OpenSans_Condensed-Regular.ttf", 30.0f); // Adjust size here
+
+        // Rebuild the font atlas
+        unsigned char* pixels;
+        int width, height;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    }
 
     // Setup skybox VAO
     GLuint skyboxVAO = setupSkyboxVAO();
+    SamplesPassedCounter skyboxSamples;
 
     std::vector<std::string> facesCubemap =
     {
@@ -273,60 +546,93 @@ int main()
         "skybox/back.png"      // nz
     };
 
-    GLuint cubemapTexture = loadCubemap(facesCubemap);
+    CubemapLoadStats cubemapStats;
+    GLuint cubemapTexture = loadCubemap(facesCubemap, &workerPool, &cubemapStats, SKYBOX_CONTAINER);
+    printCubemapLoadStats(facesCubemap, cubemapStats);
 
-    // Render loop
+    // Benchmark measurements, GPU times arrive a few frames late. Benchmarks keep every frame's
+    // pass times for the report
+    GpuFrameTimer gpuFrameTimer;
+    BenchmarkRecorder benchmarkRecorder;
+    passProfiler.keepSamples = benchmarking;
+
+    // Render loop, headless and benchmark runs go a fixed number of frames at a fixed 60 Hz step
+    // so runs are repeatable
+    const bool fixedLength = !window || benchmarking;
     float elapsedTime = 0.0f;
     float rotY = 0.0f; 
     float distApart = 2.8f;
-    while (!glfwWindowShouldClose(window))
+    int frameIndex = 0;
+    auto lastFrameEnd = std::chrono::steady_clock::now();
+    while (!(window && glfwWindowShouldClose(window)) && (!fixedLength || frameIndex < options.frames))
     {
+        TRACE_SCOPE("frame", "Frame");
+        const auto frameStart = std::chrono::steady_clock::now();
+
         // Per-frame time logic
-        float currentFrame = static_cast<float>(glfwGetTime());
-        deltaTime = currentFrame - prevFrame;
+        if (interactive)
+        {
+            float currentFrame = static_cast<float>(glfwGetTime());
+            deltaTime = currentFrame - prevFrame;
+            prevFrame = currentFrame;
+
+            // User input handling
+            TRACE_SCOPE("frame", "Input");
+            processUserInput(window);
+        }
+        else
+        {
+            deltaTime = 1.0f / 60.0f;
+            if (window && glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+                glfwSetWindowShouldClose(window, true);
+        }
+        if (!window)
+            offscreenTarget.bind();
         elapsedTime += deltaTime;
-        prevFrame = currentFrame;
 
-        // User input handling
-        processUserInput(window);
+        // Scripted runs take the camera and material from the keyframes
+        if (benchmarking)
+        {
+            const BenchmarkKeyframe key = benchmarkScript.sample(static_cast<float>(frameIndex) * deltaTime);
+            camera.setPose(key.position, key.yaw, key.pitch);
+            camera.setZoom(key.zoom);
+            etaR = key.dispersedEtaR();
+            etaG = key.etaG;
+            etaB = key.dispersedEtaB();
+            F0 = key.F0;
+            gpuFrameTimer.begin(static_cast<uint64_t>(frameIndex));
+        }
+
+        // State call counters restart every frame
+        glState.beginFrame();
+        passProfiler.beginFrame();
 
         // Clear screen colour and buffers
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+            ProfileScope pass(passProfiler, "Clear");
+            TRACE_SCOPE("frame", "Clear");
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
         // IMGUI window
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-        // Skybox
-        glDisable(GL_DEPTH_TEST);
-        skyboxShader.use();
-
-        // Remove translation component from the view matrix for the skybox
-        glm::mat4 view = glm::mat4(glm::mat3(camera.getViewMatrix()));
-        skyboxShader.setMat4("view", view);
-        glm::mat4 projection = glm::perspective(glm::radians(camera.zoom),
-            static_cast<float>(SCREEN_WIDTH) / static_cast<float>(SCREEN_HEIGHT), 0.1f, 1000.0f);
-        skyboxShader.setMat4("projection", projection);
-
-        // Bind the skybox texture and render
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        skyboxShader.setInt("skybox", 0);
-
-        glBindVertexArray(skyboxVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glEnable(GL_DEPTH_TEST);
+        if (interactive)
+        {
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplGlfw_NewFrame();
+            ImGui::NewFrame();
+        }
+
+        // Per-frame camera block, shared by the skybox and refraction programs. The camera only
+        // rebuilds its matrices after moving, and the block is only re-uploaded when they changed
+        const glm::mat4& view = camera.getViewMatrix();
+        cameraBuffer.update({ view, camera.getProjectionMatrix(), camera.getInverseProjectionMatrix(),
+            camera.getViewProjectionMatrix(), glm::vec4(camera.position, 1.0f) });
 
         // Rotate the model slowly around the y axis at 20 degrees per second
         rotY += 20.0f * deltaTime;
         rotY = fmodf(rotY, 360.0f);
 
-        // Draw models with refraction shader
-        refractionShader.use();
-
         // If eta all changed, then change all separates to be the same
         if (etaAll != etaAllPrev)
         {
@@ -334,64 +640,190 @@ int main()
             etaAllPrev = etaAll;
         }
 
-        // Model, View & Projection transformations, set uniforms in modelShader
-        view = camera.getViewMatrix();
-        refractionShader.setFloat("etaR", etaR);
-        refractionShader.setFloat("etaG", etaG);
-        refractionShader.setFloat("etaB", etaB);
-        refractionShader.setFloat("F0", F0);
-        refractionShader.setMat4("view", view);
-        refractionShader.setMat4("projection", projection);
-        glm::mat4 inverseProjection = glm::inverse(projection);
-        refractionShader.setMat4("inverseProjection", inverseProjection);
-        refractionShader.setInt("skybox", 0);
-
-        // Teapot
-        glm::vec3 modelPosition = glm::vec3(-distApart, distApart, 0.0f);
-        glm::mat4 model = glm::identity<glm::mat4>();
-        model = glm::translate(model, modelPosition);
-        model = glm::rotate(model, glm::radians(rotY), glm::vec3(0.0f, 1.0f, 0.0f));
-        refractionShader.setMat4("model", model);
-        teapotModel.draw(refractionShader);
-
-        // Sphere
-        modelPosition = glm::vec3(distApart, distApart, 0.0f);
-        model = glm::identity<glm::mat4>();
-        model = glm::translate(model, modelPosition);
-        model = glm::rotate(model, glm::radians(rotY), glm::vec3(0.0f, 1.0f, 0.0f));
-        refractionShader.setMat4("model", model);
-        sphereModel.draw(refractionShader);
-
-        // Donut
-        modelPosition = glm::vec3(-distApart, -distApart, 0.0f);
-        model = glm::identity<glm::mat4>();
-        model = glm::translate(model, modelPosition);
-        model = glm::rotate(model, glm::radians(rotY), glm::vec3(0.0f, 1.0f, 0.0f));
-        refractionShader.setMat4("model", model);
-        donutModel.draw(refractionShader);
-
-        // Monkey
-        modelPosition = glm::vec3(distApart, -distApart, 0.0f);
-        model = glm::identity<glm::mat4>();
-        model = glm::translate(model, modelPosition);
-        model = glm::rotate(model, glm::radians(rotY), glm::vec3(0.0f, 1.0f, 0.0f));
-        refractionShader.setMat4("model", model);
-        monkeyModel.draw(refractionShader);
+        // Draw models with refraction shader, material block only re-uploaded when the ImGui values change
+        materialBuffer.update({ etaR, etaG, etaB, F0 });
 
-        // IMGUI drawing
-        drawIMGUIWindow();
+        // Pick each mesh's LOD from its projected error
+        LodSelection lodSelection = makeLodSelection(camera.position, camera.zoom, static_cast<float>(SCREEN_HEIGHT), lodPixelError);
+        lodSelection.enabled = lodEnabled;
+        trianglesDrawn = 0;
+
+        // Frustum of this frame's camera, both draw paths test every mesh against it
+        frustumCuller.enabled = frustumCulling;
+        frustumCuller.begin(camera.getViewProjectionMatrix());
+
+        // Object placement (teapot, sphere, donut, monkey), the same for both draw paths
+        const glm::vec3 modelPositions[SCENE_OBJECT_COUNT] =
+        {
+            glm::vec3(-distApart, distApart, 0.0f),
+            glm::vec3(distApart, distApart, 0.0f),
+            glm::vec3(-distApart, -distApart, 0.0f),
+            glm::vec3(distApart, -distApart, 0.0f)
+        };
+        glm::mat4 modelMatrices[SCENE_OBJECT_COUNT];
+        for (int i = 0; i < SCENE_OBJECT_COUNT; i++)
+        {
+            modelMatrices[i] = glm::translate(glm::identity<glm::mat4>(), modelPositions[i]);
+            modelMatrices[i] = glm::rotate(modelMatrices[i], glm::radians(rotY), glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+
+        if (batchedDraws)
+        {
+            // Every object in one multi-draw
+            ProfileScope pass(passProfiler, "Refraction");
+            TRACE_SCOPE("frame", "Refraction");
+            for (int i = 0; i < SCENE_OBJECT_COUNT; i++)
+                sceneBatch.setTransform(sceneObjects[i], modelMatrices[i]);
+            refractionBatchShader.use();
+            trianglesDrawn = sceneBatch.draw(lodSelection, &frustumCuller);
+        }
+        else
+        {
+            // Queue every object's meshes, the queue sorts them by state and depth before drawing.
+            // With occlusion culling each object only draws if its box passed last frame, the
+            // boxes are queried again once every object is in the depth buffer
+            occlusionCuller.enabled = occlusionCulling;
+            occlusionCuller.begin();
+            {
+                ProfileScope pass(passProfiler, "Refraction");
+                TRACE_SCOPE("frame", "Refraction");
+                renderQueue.begin(view);
+                for (int i = 0; i < SCENE_OBJECT_COUNT; i++)
+                {
+                    const GLuint occlusionQuery = occlusionCuller.condition(i, sceneModels[i]->boundsMin, sceneModels[i]->boundsMax,
+                        modelMatrices[i], camera.position);
+                    trianglesDrawn += sceneModels[i]->submit(renderQueue, refractionShader, modelUniform, normalMatrixUniform,
+                        modelMatrices[i], lodSelection, &frustumCuller, occlusionQuery);
+                }
+                renderQueue.execute();
+            }
+            if (occlusionCulling)
+            {
+                ProfileScope pass(passProfiler, "Occlusion queries");
+                TRACE_SCOPE("frame", "Occlusion queries");
+                occlusionCuller.drawProxies();
+            }
+            queueStats = renderQueue.stats();
+            occlusionStats = occlusionCuller.stats();
+        }
+        cullStats = frustumCuller.stats();
 
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
+        // Skybox last, only the pixels the models left uncovered get shaded
+        {
+            ProfileScope pass(passProfiler, "Skybox");
+            TRACE_SCOPE("frame", "Skybox");
+            skyboxShader.use();
+            skyboxSamples.begin();
+            drawSkybox(skyboxVAO, cubemapTexture);
+            skyboxSamples.end();
+        }
+        skyboxFragments = skyboxSamples.samples();
+
+        // CPU time stops before any wait for the GPU or the swap, draws include the skybox
+        if (benchmarking)
+        {
+            gpuFrameTimer.end();
+            const size_t draws = (batchedDraws ? sceneBatch.drawCount() : queueStats.commands) + 1;
+            benchmarkRecorder.addFrame(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count(),
+                draws, trianglesDrawn);
+        }
+
+        frameIndex++;
+        if (!window)
+        {
+            // Nothing to present, wait for the GPU so the frame time covers the whole frame
+            passProfiler.endFrame();
+            TRACE_SCOPE("frame", "Wait for GPU");
+            glFinish();
+            const auto frameEnd = std::chrono::steady_clock::now();
+            frameTimeStats.add(std::chrono::duration<double, std::milli>(frameEnd - lastFrameEnd).count());
+            lastFrameEnd = frameEnd;
+            continue;
+        }
+
+        // IMGUI drawing
+        if (interactive)
+        {
+            ProfileScope pass(passProfiler, "ImGui");
+            TRACE_SCOPE("frame", "ImGui");
+            drawIMGUIWindow();
+        }
+        passProfiler.endFrame();
+
+        // Present through the pacer (mode and cap from the ImGui window) and poll events
+        TRACE_SCOPE("frame", "Present");
+        if (static_cast<int>(framePacer->mode()) != presentMode)
+            framePacer->setMode(static_cast<PresentMode>(presentMode));
+        if (framePacer->frameCap() != frameCapFps)
+            framePacer->setFrameCap(frameCapFps);
+        if (resetFrameStats)
+            framePacer->resetStats();
+        framePacer->present();
+        frameTimeStats = framePacer->stats();
         glfwPollEvents();
     }
 
+    if (!window)
+    {
+        std::cout << "Headless: " << frameTimeStats.frames << " frames at " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << ", "
+            << frameTimeStats.meanMs << " ms mean, " << frameTimeStats.standardDeviation() << " ms std dev, "
+            << frameTimeStats.minMs << " / " << frameTimeStats.maxMs << " ms min / max" << std::endl;
+        for (const PassTiming& pass : passProfiler.passes())
+            std::cout << "  " << std::string(pass.depth * 2, ' ') << pass.name << ": " << pass.averageGpuMs() << " ms GPU, "
+                << pass.averageCpuMs() << " ms CPU (last " << pass.recentGpuMs.size() << " frames)" << std::endl;
+        if (!options.output.empty() && offscreenTarget.writePPM(options.output))
+            std::cout << "Last frame written to " << options.output << std::endl;
+    }
+
+    if (!options.trace.empty())
+        writeTrace();
+
+    if (benchmarking)
+    {
+        gpuFrameTimer.finish();
+        for (const std::pair<uint64_t, double>& result : gpuFrameTimer.results())
+            benchmarkRecorder.setGpuTime(result.first, result.second);
+        passProfiler.finish();
+        for (const PassTiming& pass : passProfiler.passes())
+            benchmarkRecorder.addPass(pass.name, pass.cpuSamples, pass.gpuSamples);
+
+        std::ostringstream description;
+        description << "\"script\": " << jsonString(benchmarkScript.path) << ",\n"
+            << "  \"renderer\": " << jsonString(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) << ",\n"
+            << "  \"resolution\": [" << SCREEN_WIDTH << ", " << SCREEN_HEIGHT << "],\n"
+            << "  \"headless\": " << (window ? "false" : "true") << ",\n"
+            << "  \"batched_draws\": " << (batchedDraws ? "true" : "false") << ",\n"
+            << "  \"timestep_ms\": " << 1000.0 / 60.0;
+        if (benchmarkRecorder.writeReport(options.report, description.str()))
+            std::cout << "Benchmark: " << benchmarkRecorder.frames() << " frames of " << options.benchmark
+                << ", report written to " << options.report << std::endl;
+    }
+
     // Shutdown procedure
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    if (interactive)
+    {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+    }
 
-    // Destroy window
+    // Release GL objects owned here while the context is alive
+    cameraBuffer.destroy();
+    materialBuffer.destroy();
+    sceneBatch.destroy();
+    skyboxSamples.destroy();
+    occlusionCuller.destroy();
+    gpuFrameTimer.destroy();
+    passProfiler.destroy();
+
+    // Destroy window, textures still referenced by the models die with the context
+    TextureRegistry::instance().detachContext();
+    if (!window)
+    {
+        offscreenTarget.destroy();
+        headlessContext.destroy();
+        return 0;
+    }
     glfwDestroyWindow(window);
 
     // Terminate and return success
@@ -401,6 +833,7 @@ int main()
 
 // Process keyboard inputs
 bool IKeyReleased = true;
+bool TKeyReleased = true;
 void processUserInput(GLFWwindow* window)
 {
     // Escape to exit
@@ -446,6 +879,15 @@ void processUserInput(GLFWwindow* window)
     // Debouncer for I key
     if (glfwGetKey(window, GLFW_KEY_I) == GLFW_RELEASE)
         IKeyReleased = true;
+
+    // T writes the trace recorded so far
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS && TKeyReleased)
+    {
+        TKeyReleased = false;
+        writeTrace();
+    }
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_RELEASE)
+        TKeyReleased = true;
 }
 
 // Window size change callback
@@ -457,6 +899,8 @@ void frameBufferSizeCallback(GLFWwindow* window, int width, int height)
     // Adjust screen width and height params that set the aspect ratio in the projection matrix
     SCREEN_WIDTH = width;
     SCREEN_HEIGHT = height;
+    if (width > 0 && height > 0)
+        camera.setProjection(static_cast<float>(width) / static_cast<float>(height), camera.nearPlane, camera.farPlane);
 }
 
 // Mouse input callback